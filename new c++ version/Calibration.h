@@ -20,16 +20,51 @@
 #ifndef CALIBRATION_H
 #define CALIBRATION_H
 #include <iostream>
+#include <stdint.h>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <limits>
 
 using namespace std;
 
+/**
+ * Estimates the empty scene from the first numFrames frames.
+ *
+ * Per pixel either the mean (MEAN, streaming sums) or the median (MEDIAN,
+ * keeps all numFrames frames) over the samples that carry a depth value is
+ * computed; zero means "no value" and is skipped. Pixels without any valid
+ * sample end up as 0. The work is split into bands of pixels that run on
+ * numThreads threads, the per band loops are plain enough for the compiler
+ * to vectorize. The threads are started by the first calibrate() and wait
+ * for the next frame between calls.
+ *
+ * MEDIAN holds depthMapSize * numFrames samples until the last frame, about
+ * 400 MB for 100 uint16_t frames of 1920x1080 and twice that for float, so
+ * keep numFrames small there and use MEAN for long calibrations.
+ *
+ * The surfaces are ready once calibrate() has seen numFrames frames. Use
+ * initialize() to start a background model from the result.
+ */
 class Calibration {
 public:
 
-    Calibration() {
+    enum Mode {
+        MEAN,
+        MEDIAN
+    };
+
+    Calibration() : calibrationSurface(NULL), uint16_t_calibrationSurface(NULL), depthMapSize(0), numFrames(0), cnt(0), mode(MEAN), numThreads(1), workRound(0), workBands(1), workRunning(0), workExit(false) {
     }
 
-    Calibration(int depthMapSize, int numFrames) : depthMapSize(depthMapSize), numFrames(numFrames), cnt(0) {
+    Calibration(int depthMapSize, int numFrames, Mode mode = MEAN, int numThreads = 0) : depthMapSize(depthMapSize), numFrames(numFrames), cnt(0), mode(mode), numThreads(numThreads), workRound(0), workBands(1), workRunning(0), workExit(false) {
+        if (this->numThreads <= 0) {
+            this->numThreads = std::max(1, (int) std::thread::hardware_concurrency());
+        }
         calibrationSurface = new float[depthMapSize];
         uint16_t_calibrationSurface = new uint16_t[depthMapSize];
         reset();
@@ -39,30 +74,17 @@ public:
         this->cnt = 0;
         memset(calibrationSurface, 0, depthMapSize * sizeof (float));
         memset(uint16_t_calibrationSurface, 0, depthMapSize * sizeof (uint16_t));
+        floatSums.assign(floatSums.size(), 0);
+        uint16_t_sums.assign(uint16_t_sums.size(), 0);
+        counts.assign(counts.size(), 0);
     }
 
     bool calibrate(float* depthMap) {
-        if (this->cnt < numFrames) {
-            for (int i = 0; i < this->depthMapSize; i++) {
-                calibrationSurface[i] = (calibrationSurface[i] + depthMap[i]) / 2.0;
-            }
-            this->cnt++;
-        } else {
-            return true;
-        }
-        return false;
+        return add(depthMap, floatSums, floatFrames, calibrationSurface);
     }
 
     bool calibrate(uint16_t* depthMap) {
-        if (this->cnt < numFrames) {
-            for (int i = 0; i < this->depthMapSize; i++) {
-                uint16_t_calibrationSurface[i] = (uint16_t_calibrationSurface[i] + depthMap[i]) / 2.0;
-            }
-            this->cnt++;
-        } else {
-            return true;
-        }
-        return false;
+        return add(depthMap, uint16_t_sums, uint16_t_frames, uint16_t_calibrationSurface);
     }
 
     float* getAverageFLOATSurface() {
@@ -73,6 +95,16 @@ public:
         return this->uint16_t_calibrationSurface;
     }
 
+    /**
+     * Starts a background model of the same size from the calibrated
+     * surface. The model has to provide setBackground(), see
+     * BackgroundModel; writing into getThresholds() would be lost on models
+     * that derive their thresholds from statistics of their own.
+     */
+    template <typename BACKGROUNDMODEL> void initialize(BACKGROUNDMODEL* model) {
+        model->setBackground(this->uint16_t_calibrationSurface);
+    }
+
     void setNumFrames(int value) {
         this->numFrames = value;
     }
@@ -85,9 +117,26 @@ public:
         return this->cnt;
     }
 
+    void setMode(Mode value) {
+        this->mode = value;
+    }
+
+    Mode getMode() {
+        return this->mode;
+    }
+
+    void setNumThreads(int value) {
+        this->numThreads = value > 0 ? value : 1;
+    }
+
+    int getNumThreads() {
+        return this->numThreads;
+    }
+
     virtual ~Calibration() {
-        delete calibrationSurface;
-        delete uint16_t_calibrationSurface;
+        stopWorkers();
+        delete[] calibrationSurface;
+        delete[] uint16_t_calibrationSurface;
     }
 
 private:
@@ -96,6 +145,169 @@ private:
     int depthMapSize;
     int numFrames;
     int cnt;
+    Mode mode;
+    int numThreads;
+
+    // MEAN: running sums and valid sample counts
+    std::vector<double> floatSums;
+    std::vector<uint64_t> uint16_t_sums;
+    std::vector<uint32_t> counts;
+
+    // MEDIAN: all frames, frame after frame
+    std::vector<float> floatFrames;
+    std::vector<uint16_t> uint16_t_frames;
+
+    // bands - 1 threads that run workJob on band 1 and up, see parallel()
+    std::vector<std::thread> workers;
+    std::mutex workMutex;
+    std::condition_variable workStart;
+    std::condition_variable workStopped;
+    std::function<void(int, int)> workJob;
+    uint64_t workRound;
+    int workBands;
+    int workRunning;
+    bool workExit;
+
+    void workerLoop(const int band, uint64_t round) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(this->workMutex);
+                while (this->workRound == round && !this->workExit) {
+                    this->workStart.wait(lock);
+                }
+                if (this->workExit) {
+                    return;
+                }
+                round = this->workRound;
+            }
+            this->workJob((int) ((int64_t) band * depthMapSize / this->workBands), (int) ((int64_t) (band + 1) * depthMapSize / this->workBands));
+            std::lock_guard<std::mutex> lock(this->workMutex);
+            if (--this->workRunning == 0) {
+                this->workStopped.notify_one();
+            }
+        }
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(this->workMutex);
+            this->workExit = true;
+            this->workStart.notify_all();
+        }
+        for (size_t i = 0; i < this->workers.size(); i++) {
+            this->workers[i].join();
+        }
+        this->workers.clear();
+        this->workExit = false;
+    }
+
+    // runs job(begin, end) on numThreads bands of pixels
+    template <typename JOB> void parallel(JOB job) {
+        int bands = std::min(this->numThreads, std::max(1, this->depthMapSize / 4096));
+        if (bands == 1) {
+            job(0, depthMapSize);
+            return;
+        }
+        if ((int) this->workers.size() != bands - 1) {
+            stopWorkers();
+            for (int b = 1; b < bands; b++) {
+                this->workers.push_back(std::thread(&Calibration::workerLoop, this, b, this->workRound));
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->workMutex);
+            this->workJob = job;
+            this->workBands = bands;
+            this->workRunning = bands - 1;
+            this->workRound++;
+            this->workStart.notify_all();
+        }
+        job(0, depthMapSize / bands);
+        std::unique_lock<std::mutex> lock(this->workMutex);
+        while (this->workRunning > 0) {
+            this->workStopped.wait(lock);
+        }
+    }
+
+    template <typename T, typename S> bool add(const T* depthMap, std::vector<S>& sums, std::vector<T>& frames, T* surface) {
+        if (this->cnt >= numFrames) {
+            return true;
+        }
+
+        if (mode == MEAN) {
+            if (sums.size() != (size_t) depthMapSize) {
+                sums.assign(depthMapSize, 0);
+                counts.assign(depthMapSize, 0);
+            }
+            S* sum = &sums[0];
+            uint32_t* count = &counts[0];
+            parallel([=](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    T d = depthMap[i];
+                    sum[i] += d;
+                    count[i] += d != 0; // 0 == NO_VALUE
+                }
+            });
+        } else {
+            if (frames.size() != (size_t) depthMapSize * numFrames) {
+                frames.resize((size_t) depthMapSize * numFrames);
+            }
+            memcpy(&frames[(size_t) this->cnt * depthMapSize], depthMap, depthMapSize * sizeof (T));
+        }
+
+        this->cnt++;
+        if (this->cnt == numFrames) {
+            finish(sums, frames, surface);
+            // keep both surfaces filled, whichever input type was calibrated
+            if ((void*) surface == (void*) calibrationSurface) {
+                for (int i = 0; i < depthMapSize; i++) {
+                    float v = calibrationSurface[i];
+                    uint16_t_calibrationSurface[i] = v <= 0 ? 0 : (v >= 65535 ? 65535 : (uint16_t) (v + 0.5f));
+                }
+            } else {
+                for (int i = 0; i < depthMapSize; i++) {
+                    calibrationSurface[i] = uint16_t_calibrationSurface[i];
+                }
+            }
+        }
+        return false;
+    }
+
+    template <typename T, typename S> void finish(std::vector<S>& sums, std::vector<T>& frames, T* surface) {
+        const int size = depthMapSize;
+        const int n = numFrames;
+
+        if (mode == MEAN) {
+            const S* sum = &sums[0];
+            const uint32_t* count = &counts[0];
+            const double rounding = std::numeric_limits<T>::is_integer ? 0.5 : 0.0;
+            parallel([=](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    surface[i] = count[i] == 0 ? 0 : (T) ((double) sum[i] / count[i] + rounding);
+                }
+            });
+        } else {
+            const T* frame = &frames[0];
+            parallel([=](int begin, int end) {
+                std::vector<T> samples(n);
+                for (int i = begin; i < end; i++) {
+                    int valid = 0;
+                    for (int f = 0; f < n; f++) {
+                        T d = frame[(size_t) f * size + i];
+                        samples[valid] = d;
+                        valid += d != 0;
+                    }
+                    if (valid == 0) {
+                        surface[i] = 0;
+                    } else {
+                        std::nth_element(samples.begin(), samples.begin() + valid / 2, samples.begin() + valid);
+                        surface[i] = samples[valid / 2];
+                    }
+                }
+            });
+            std::vector<T>().swap(frames);
+        }
+    }
 };
 
 #endif /* CALIBRATION_H */
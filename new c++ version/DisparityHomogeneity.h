@@ -0,0 +1,94 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DISPARITYHOMOGENEITY_H
+#define DISPARITYHOMOGENEITY_H
+
+#include <homogeneity.h>
+#include <disparitylut.h>
+#include <cmath>
+
+/**
+ * KinectHomogeneity for frames of raw 11 bit disparity.
+ *
+ * update(uint16_t*) takes the raw frame as it comes from the sensor. The
+ * criterion converts only the pixels the tracker asks for, with a
+ * DisparityLUT, and gates and compares in mm like KinectHomogeneity. The
+ * background model works in mm as well: the frame is converted as a whole
+ * only when the background is updated, by a table lookup per pixel.
+ *
+ * Calibrate the background with frames converted by the same table, e.g.
+ * DepthPreprocessor with setDisparityTable().
+ */
+template <typename BACKGROUNDMODEL> class DisparityHomogeneity : public Homogeneity<BACKGROUNDMODEL> {
+private:
+    DisparityLUT lut;
+    uint16_t* disparity;
+    uint16_t* millimetres;
+
+public:
+
+    DisparityHomogeneity(uint16_t* disparityMap, int width, int height) : Homogeneity<BACKGROUNDMODEL>(disparityMap, width, height), disparity(disparityMap), millimetres(new uint16_t[width * height]) {
+    }
+
+    virtual ~DisparityHomogeneity() {
+        if (this->millimetres != NULL) {
+            delete[] this->millimetres;
+        }
+    }
+
+    virtual void update(uint16_t* disparityMap) {
+        this->disparity = disparityMap;
+        Homogeneity<BACKGROUNDMODEL>::setCurrent(disparityMap);
+    }
+
+    virtual void update(int* occu) {
+        Homogeneity<BACKGROUNDMODEL>::update(occu);
+    }
+
+    virtual void updateBackground(uint16_t* disparityMap, int* occu) {
+        int size = Homogeneity<BACKGROUNDMODEL>::getWidth() * Homogeneity<BACKGROUNDMODEL>::getHeight();
+        this->lut.apply(disparityMap, this->millimetres, size);
+        Homogeneity<BACKGROUNDMODEL>::updateBackground(this->millimetres, occu);
+    }
+
+    virtual bool getCriteria(int x, int y) {
+        int width = Homogeneity<BACKGROUNDMODEL>::getWidth();
+        int currentDistance = this->lut.toMillimetres(this->disparity[y * width + x]);
+
+        if (currentDistance == 0 || currentDistance > Homogeneity<BACKGROUNDMODEL>::getMaxDistance() || currentDistance < Homogeneity<BACKGROUNDMODEL>::getMinDistance()) {
+            return false;
+        }
+
+        int threshold = Homogeneity<BACKGROUNDMODEL>::getBackgroundModel()->getThreshold(x, y);
+        return currentDistance < threshold && threshold - currentDistance > Homogeneity<BACKGROUNDMODEL>::getThresholdOffset();
+    }
+
+    // the current frame in mm, valid after the last background update
+    uint16_t* getMillimetres() {
+        return this->millimetres;
+    }
+
+    const DisparityLUT& getDisparityLUT() {
+        return this->lut;
+    }
+};
+
+#endif /* DISPARITYHOMOGENEITY_H */
@@ -0,0 +1,190 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ
+ * email: christ_o@gmx.de
+ *
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GAUSSIANBACKGROUNDMODEL_H
+#define GAUSSIANBACKGROUNDMODEL_H
+#include <backgroundmodel.h>
+#include <occupancymask.h>
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+/**
+ * Running mean and variance of the depth per pixel.
+ *
+ * Mean (Q8 fixed point, mm) and variance (mm^2) are exponential averages with
+ * a learning rate of 2^-learningRateShift, updated for every pixel whose 5x5
+ * neighbourhood is free and that has a depth value. The threshold handed to
+ * Homogeneity is mean - k * sigma, so a pixel counts as foreground when it is
+ * more than k standard deviations (plus the homogeneity's threshold offset)
+ * in front of the background. Noisy pixels get a wide margin, stable ones a
+ * tight one.
+ *
+ * The update is one branch-free loop per row; it vectorizes as long as sqrt
+ * does not have to set errno (build with -fno-math-errno).
+ */
+class GaussianBackgroundModel : public BackgroundModel {
+public:
+
+    GaussianBackgroundModel(uint16_t* depthMap, int width, int height) : BackgroundModel(depthMap, width, height), occupancyMask(width, height, 2), mean(new int32_t[2 * width * height]), variance(mean + width * height), learningRateShift(5), k(3.0f), initialVariance(400), minVariance(4) {
+        std::memset(this->mean, 0, 2 * width * height * sizeof (int32_t));
+    }
+
+    virtual ~GaussianBackgroundModel() {
+        // variance lives in the same allocation
+        if (this->mean != NULL) {
+            delete[] this->mean;
+        }
+    }
+
+    virtual void update(uint16_t* depthMap) {
+        setDepthmap(depthMap);
+    }
+
+    virtual void update(int* occu) {
+        update(occu, 0, 0, getWidth(), getHeight());
+    }
+
+    virtual void update(int* occu, int x0, int y0, int x1, int y1) {
+        occupancyMask.update(occu, x0, y0, x1, y1);
+
+        for (int y = y0; y < y1; y++) {
+            updateRow(y * getWidth() + x0, x1 - x0);
+        }
+    }
+
+    // mean from the background, initialVariance where it has a value
+    virtual void setBackground(const uint16_t* background) {
+        uint16_t* thresholds = getThresholds();
+        const int n = getWidth() * getHeight();
+        for (int i = 0; i < n; i++) {
+            this->mean[i] = background[i] << 8;
+            this->variance[i] = background[i] == 0 ? 0 : this->initialVariance;
+            float t = background[i] - this->k * std::sqrt((float) this->variance[i]);
+            thresholds[i] = background[i] == 0 || t < 0 ? 0 : (uint16_t) t;
+        }
+    }
+
+    // mean followed by variance
+    virtual size_t getStateSize() {
+        return 2 * getWidth() * getHeight() * sizeof (int32_t);
+    }
+
+    virtual void* getState() {
+        return this->mean;
+    }
+
+    // mean in mm
+    float getMean(int x, int y) {
+        return this->mean[y * getWidth() + x] / 256.0f;
+    }
+
+    float getSigma(int x, int y) {
+        return std::sqrt((float) this->variance[y * getWidth() + x]);
+    }
+
+    // learning rate is 2^-value
+    void setLearningRateShift(int value) {
+        this->learningRateShift = value;
+    }
+
+    int getLearningRateShift() {
+        return this->learningRateShift;
+    }
+
+    void setK(float value) {
+        this->k = value;
+    }
+
+    float getK() {
+        return this->k;
+    }
+
+    // variance in mm^2 given to a pixel on its first valid sample
+    void setInitialVariance(int32_t value) {
+        this->initialVariance = value;
+    }
+
+    int32_t getInitialVariance() {
+        return this->initialVariance;
+    }
+
+    // lower bound for the variance, the noise floor of the sensor in mm^2
+    void setMinVariance(int32_t value) {
+        this->minVariance = value;
+    }
+
+    int32_t getMinVariance() {
+        return this->minVariance;
+    }
+
+private:
+    // differences are clamped so that their square fits the 32 bit variance
+    static const int32_t MAX_DIFFERENCE = 4095;
+
+    OccupancyMask occupancyMask;
+    int32_t* mean;
+    int32_t* variance;
+    int learningRateShift;
+    float k;
+    int32_t initialVariance;
+    int32_t minVariance;
+
+    void updateRow(const int& offset, const int& count) {
+        const uint8_t* mask = occupancyMask.getMask() + offset;
+        const uint16_t* depth = getDepthmap() + offset;
+        uint16_t* thresholds = getThresholds() + offset;
+        int32_t* m = this->mean + offset;
+        int32_t* v = this->variance + offset;
+        const int shift = this->learningRateShift;
+        const float kk = this->k;
+        const int32_t v0 = this->initialVariance;
+        const int32_t vmin = this->minVariance;
+        const int32_t limit = MAX_DIFFERENCE;
+
+        for (int i = 0; i < count; i++) {
+            int32_t d = depth[i];
+            int32_t x = d << 8;
+            int32_t mi = m[i];
+            int32_t vi = v[i];
+            bool valid = mask[i] == 0 && d != 0;
+            bool fresh = mi == 0;
+
+            int32_t diff = x - mi;
+            int32_t mm = diff >> 8;
+            mm = mm > limit ? limit : (mm < -limit ? -limit : mm);
+            int32_t nm = fresh ? x : mi + (diff >> shift);
+            int32_t nv = fresh ? v0 : vi + ((mm * mm - vi) >> shift);
+            nv = nv < vmin ? vmin : nv;
+
+            mi = valid ? nm : mi;
+            vi = valid ? nv : vi;
+            m[i] = mi;
+            v[i] = vi;
+
+            float t = mi * (1.0f / 256.0f) - kk * std::sqrt((float) vi);
+            t = t < 0 ? 0 : t;
+            thresholds[i] = mi == 0 ? thresholds[i] : (uint16_t) t;
+        }
+    }
+};
+
+#endif /* GAUSSIANBACKGROUNDMODEL_H */
@@ -20,6 +20,7 @@
 #ifndef KINECTBACKGROUNDMODEL_H
 #define KINECTBACKGROUNDMODEL_H
 #include <backgroundmodel.h>
+#include <occupancymask.h>
 #include <stdint.h>
 #include <iostream>
 #include <cstring>
@@ -29,61 +30,42 @@ using namespace std;
 class KinectBackgroundModel : public BackgroundModel {
 public:
 
-    KinectBackgroundModel(uint16_t* depthMap, int width, int height) : BackgroundModel(depthMap, width, height) {
+    KinectBackgroundModel(uint16_t* depthMap, int width, int height) : BackgroundModel(depthMap, width, height), occupancyMask(width, height, 2) {
     }
 
     virtual void update(uint16_t* depthMap) {
         setDepthmap(depthMap);
     }
 
+    /**
+     * Moves the threshold of every pixel whose 5x5 neighbourhood is free
+     * halfway towards the current depth. Pixels without a depth value are
+     * left alone.
+     */
     virtual void update(int* occu) {
+        update(occu, 0, 0, getWidth(), getHeight());
+    }
+
+    virtual void update(int* occu, int x0, int y0, int x1, int y1) {
+        occupancyMask.update(occu, x0, y0, x1, y1);
 
-        for (int y = 1; y < getHeight() - 1; y++) {
-            for (int x = 1; x < getWidth() - 1; x++) {
-                int center = (y) * getWidth() + (x);
-                int topLeft = (y - 1) * getWidth() + (x - 1);
-                int topLeft_2 = (y - 2) * getWidth() + (x - 2);
-                int top = (y - 1) * getWidth() + (x);
-                int top_2 = (y - 2) * getWidth() + (x);
-                int topRight = (y - 1) * getWidth() + (x + 1);
-                int topRight_2 = (y - 2) * getWidth() + (x + 2);
-                int left = (y) * getWidth() + (x - 1);
-                int left_2 = (y) * getWidth() + (x - 2);
-                int right = (y) * getWidth() + (x + 1);
-                int right_2 = (y) * getWidth() + (x + 2);
-                int bottomleft = (y + 1) * getWidth() + (x - 1);
-                int bottomleft_2 = (y + 2) * getWidth() + (x - 2);
-                int bottom = (y - 1) * getWidth() + (x);
-                int bottom_2 = (y - 2) * getWidth() + (x);
-                int bottomRight = (y - 1) * getWidth() + (x + 1);
-                int bottomRight_2 = (y - 2) * getWidth() + (x + 2);
+        for (int y = y0; y < y1; y++) {
+            const int offset = y * getWidth() + x0;
+            const uint8_t* mask = occupancyMask.getMask() + offset;
+            const uint16_t* depth = getDepthmap() + offset;
+            uint16_t* thresholds = getThresholds() + offset;
 
-                if (occu[center] == 0 &&
-                        occu[topLeft] == 0 &&
-                        occu[topLeft_2] == 0 &&
-                        occu[top] == 0 &&
-                        occu[top_2] == 0 &&
-                        occu[topRight] == 0 &&
-                        occu[topRight_2] == 0 &&
-                        occu[left] == 0 &&
-                        occu[left_2] == 0 &&
-                        occu[right] == 0 &&
-                        occu[right_2] == 0 &&
-                        occu[bottomleft] == 0 &&
-                        occu[bottomleft_2] == 0 &&
-                        occu[bottom] == 0 &&
-                        occu[bottom_2] == 0 &&
-                        occu[bottomRight] == 0 &&
-                        occu[bottomRight_2] == 0 &&
-                        getDepthmap()[center] != 0) { // 0 == NO_VALUE
-                    getThresholds()[center] = (getDepthmap()[center] + getThresholds()[center]) / 2;
-                }
+            for (int i = 0; i < x1 - x0; i++) {
+                uint16_t d = depth[i];
+                uint16_t t = thresholds[i];
+                uint16_t blended = (uint16_t) (((uint32_t) d + t) >> 1);
+                thresholds[i] = (mask[i] == 0 && d != 0) ? blended : t; // 0 == NO_VALUE
             }
         }
     }
 
 private:
-
+    OccupancyMask occupancyMask;
 };
 
 #endif /* KINECTBACKGROUNDMODEL_H */
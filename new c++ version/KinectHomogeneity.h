@@ -11,15 +11,22 @@
 #include <backgroundmodel.h>
 #include <homogeneity.h>
 #include <iostream>
+#include <cassert>
 #include <stdlib.h>
 #include <complex>
 #include <stdbool.h>
 using namespace std;
 
-template <typename BACKGROUNDMODEL> class KinectHomogeneity : public Homogeneity<BACKGROUNDMODEL> {
+/**
+ * WIDTH and HEIGHT fix the frame size at compile time (0: as given to the
+ * constructor, which has to match a fixed size), which makes the row stride
+ * in getCriteria() a constant.
+ */
+template <typename BACKGROUNDMODEL, int WIDTH = 0, int HEIGHT = 0> class KinectHomogeneity : public Homogeneity<BACKGROUNDMODEL> {
 public:
 
-    KinectHomogeneity(uint16_t* depthMap, int width, int height) : Homogeneity<BACKGROUNDMODEL>(depthMap, width, height) {
+    KinectHomogeneity(uint16_t* depthMap, int width, int height) : Homogeneity<BACKGROUNDMODEL>(depthMap, WIDTH > 0 ? WIDTH : width, HEIGHT > 0 ? HEIGHT : height) {
+        assert((WIDTH <= 0 || width == WIDTH) && (HEIGHT <= 0 || height == HEIGHT));
     }
 
     virtual void update(uint16_t* depthMap) {
@@ -27,21 +34,19 @@ public:
     }
 
     virtual void update(int* occu) {
-
-        Homogeneity<BACKGROUNDMODEL>::getBackgroundModel()->update(Homogeneity<BACKGROUNDMODEL>::getCurrent());
-        Homogeneity<BACKGROUNDMODEL>::getBackgroundModel()->update(occu);
+        Homogeneity<BACKGROUNDMODEL>::update(occu);
     }
 
     virtual bool getCriteria(int x, int y) {
         int sum = 0;
         double currentDistance = 0;
 
-        int width = Homogeneity<BACKGROUNDMODEL>::getWidth();
-        int height = Homogeneity<BACKGROUNDMODEL>::getHeight();
+        int width = WIDTH > 0 ? WIDTH : Homogeneity<BACKGROUNDMODEL>::getWidth();
 
         uint16_t* currentPtr = Homogeneity<BACKGROUNDMODEL>::getCurrent();
 
-        currentDistance = this->getValue(currentPtr, 1, x, y, width, height);
+        // the tracker only asks for cells inside the frame
+        currentDistance = currentPtr[y * width + x];
 
         if (currentDistance == 0 || currentDistance > Homogeneity<BACKGROUNDMODEL>::getMaxDistance() || currentDistance < Homogeneity<BACKGROUNDMODEL>::getMinDistance()) {
             return false;
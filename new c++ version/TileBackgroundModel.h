@@ -0,0 +1,330 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ
+ * email: christ_o@gmx.de
+ *
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILEBACKGROUNDMODEL_H
+#define TILEBACKGROUNDMODEL_H
+#include <config.h>
+#include <backgroundmodel.h>
+#include <stdint.h>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+class TileStatistics {
+public:
+    uint16_t median;
+    uint16_t mad; // median absolute deviation
+    float validRatio; // share of pixels with a depth value
+    bool initialized;
+
+    TileStatistics() : median(0), mad(0), validRatio(0), initialized(false) {
+    }
+};
+
+/**
+ * Background model made of per tile statistics.
+ *
+ * Every tile keeps the median, the median absolute deviation and the share of
+ * valid pixels of the background depth. Detail within a tile comes from a
+ * residual per blockSize x blockSize block, the mean background depth of the
+ * free pixels of the block minus the median of the tile that holds the
+ * block's top left pixel. The background depth of a pixel is that median plus
+ * the residual of its block, also where the block reaches into the next tile;
+ * with 4x4 blocks the residuals take 1/16 of the memory of a full resolution
+ * threshold map.
+ *
+ * A tile is only re-estimated while none of its pixels is occupied; the new
+ * statistics are averaged with the old ones like KinectBackgroundModel does
+ * per pixel. isTileUnchanged() tests a sparse sample of the current frame
+ * against the statistics, so callers can skip work on tiles that show plain
+ * background.
+ *
+ * The thresholds of BackgroundModel are written for the blocks of every tile
+ * that is re-estimated, so getThreshold() is a lookup, double buffering and
+ * BackgroundSnapshot work as with the other models, and getState() holds
+ * the tile statistics followed by the residuals.
+ */
+class TileBackgroundModel : public BackgroundModel {
+private:
+    int width, height;
+    int numTilesX, numTilesY;
+    int blockSize;
+    int blocksX, blocksY;
+    uint8_t* state; // tiles, then residuals
+    TileStatistics* tiles;
+    int16_t* residuals;
+    int* tileColumn;
+    int* tileRow;
+    uint16_t* scratch;
+
+    size_t stateSize() const {
+        return this->numTilesX * this->numTilesY * sizeof (TileStatistics) + this->blocksX * this->blocksY * sizeof (int16_t);
+    }
+
+    void allocate() {
+        this->state = new uint8_t[stateSize()];
+        this->tiles = (TileStatistics*) this->state;
+        this->residuals = (int16_t*) (this->state + this->numTilesX * this->numTilesY * sizeof (TileStatistics));
+        for (int i = 0; i < this->numTilesX * this->numTilesY; i++) {
+            this->tiles[i] = TileStatistics();
+        }
+        std::memset(this->residuals, 0, this->blocksX * this->blocksY * sizeof (int16_t));
+        this->tileColumn = new int[this->width];
+        this->tileRow = new int[this->height];
+        for (int tx = 0; tx < this->numTilesX; tx++) {
+            for (int x = tileX0(tx); x < tileX0(tx + 1); x++) {
+                this->tileColumn[x] = tx;
+            }
+        }
+        for (int ty = 0; ty < this->numTilesY; ty++) {
+            for (int y = tileY0(ty); y < tileY0(ty + 1); y++) {
+                this->tileRow[y] = ty;
+            }
+        }
+        int maxTileSize = (this->width / this->numTilesX + 1) * (this->height / this->numTilesY + 1);
+        this->scratch = new uint16_t[maxTileSize];
+    }
+
+    void release() {
+        delete[] this->state;
+        delete[] this->tileColumn;
+        delete[] this->tileRow;
+        delete[] this->scratch;
+    }
+
+    int tileX0(const int& tx) const {
+        return tx * this->width / this->numTilesX;
+    }
+
+    int tileY0(const int& ty) const {
+        return ty * this->height / this->numTilesY;
+    }
+
+    bool isOccupied(const int* occu, const int& tx, const int& ty) const {
+        for (int y = tileY0(ty); y < tileY0(ty + 1); y++) {
+            const int* row = occu + y * this->width;
+            for (int x = tileX0(tx); x < tileX0(tx + 1); x++) {
+                if (row[x] != 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // background depth of a pixel from the statistics
+    int estimate(const int& x, const int& y) const {
+        // the residual is relative to the tile that owns the block
+        const int bx = x / this->blockSize;
+        const int by = y / this->blockSize;
+        const TileStatistics& tile = this->tiles[this->tileRow[by * this->blockSize] * this->numTilesX + this->tileColumn[bx * this->blockSize]];
+        int t = tile.median + this->residuals[by * this->blocksX + bx];
+        return t < 0 ? 0 : (t > 65535 ? 65535 : t);
+    }
+
+    // occu may be NULL, otherwise occupied pixels of blocks reaching into other tiles are left out
+    void updateTile(const int* occu, const int& tx, const int& ty) {
+        const uint16_t* depthMap = getDepthmap();
+        const int x0 = tileX0(tx), x1 = tileX0(tx + 1);
+        const int y0 = tileY0(ty), y1 = tileY0(ty + 1);
+
+        int n = 0;
+        for (int y = y0; y < y1; y++) {
+            const uint16_t* row = depthMap + y * this->width;
+            for (int x = x0; x < x1; x++) {
+                if (row[x] != 0) { // 0 == NO_VALUE
+                    this->scratch[n++] = row[x];
+                }
+            }
+        }
+
+        TileStatistics& tile = this->tiles[ty * this->numTilesX + tx];
+        tile.validRatio = (float) n / ((x1 - x0) * (y1 - y0));
+        if (n == 0) {
+            return;
+        }
+
+        std::nth_element(this->scratch, this->scratch + n / 2, this->scratch + n);
+        uint16_t median = this->scratch[n / 2];
+        for (int i = 0; i < n; i++) {
+            this->scratch[i] = this->scratch[i] > median ? this->scratch[i] - median : median - this->scratch[i];
+        }
+        std::nth_element(this->scratch, this->scratch + n / 2, this->scratch + n);
+        uint16_t mad = this->scratch[n / 2];
+
+        bool first = !tile.initialized;
+        if (!first) {
+            tile.median = (tile.median + median) / 2;
+            tile.mad = (tile.mad + mad) / 2;
+        } else {
+            tile.median = median;
+            tile.mad = mad;
+            tile.initialized = true;
+        }
+
+        // blocks are assigned to the tile that holds their top left pixel
+        uint16_t* thresholds = getThresholds();
+        const int bx0 = (x0 + this->blockSize - 1) / this->blockSize, bx1 = (x1 + this->blockSize - 1) / this->blockSize;
+        const int by0 = (y0 + this->blockSize - 1) / this->blockSize, by1 = (y1 + this->blockSize - 1) / this->blockSize;
+        for (int by = by0; by < by1; by++) {
+            for (int bx = bx0; bx < bx1; bx++) {
+                int sum = 0;
+                int count = 0;
+                int yEnd = std::min((by + 1) * this->blockSize, this->height);
+                int xEnd = std::min((bx + 1) * this->blockSize, this->width);
+                for (int y = by * this->blockSize; y < yEnd; y++) {
+                    for (int x = bx * this->blockSize; x < xEnd; x++) {
+                        uint16_t d = depthMap[y * this->width + x];
+                        bool valid = d != 0 && (occu == NULL || occu[y * this->width + x] == 0);
+                        sum += valid ? d : 0;
+                        count += valid;
+                    }
+                }
+                int16_t& r = this->residuals[by * this->blocksX + bx];
+                if (count > 0) {
+                    int residual = sum / count - tile.median;
+                    residual = std::max(-32768, std::min(32767, residual));
+                    r = (int16_t) (first ? residual : (r + residual) / 2);
+                }
+                int t = std::max(0, std::min(65535, tile.median + r));
+                for (int y = by * this->blockSize; y < yEnd; y++) {
+                    for (int x = bx * this->blockSize; x < xEnd; x++) {
+                        thresholds[y * this->width + x] = (uint16_t) t;
+                    }
+                }
+            }
+        }
+        // the blocks may reach into the next tile
+        markUpdated(bx0 * this->blockSize, by0 * this->blockSize, std::min(bx1 * this->blockSize, this->width), std::min(by1 * this->blockSize, this->height));
+    }
+
+public:
+
+    TileBackgroundModel(uint16_t* depthMap, int width, int height) : BackgroundModel(depthMap, width, height), width(width), height(height), numTilesX(NUM_TILES_X), numTilesY(NUM_TILES_Y), blockSize(4), blocksX((width + 3) / 4), blocksY((height + 3) / 4) {
+        setDepthmap(depthMap);
+        allocate();
+    }
+
+    virtual ~TileBackgroundModel() {
+        release();
+    }
+
+    /**
+     * Changes the tiling, e.g. to tracker_num_tiles_x/y, and drops all
+     * statistics and thresholds.
+     */
+    void setNumTiles(int numTilesX, int numTilesY) {
+        release();
+        this->numTilesX = numTilesX;
+        this->numTilesY = numTilesY;
+        allocate();
+        std::memset(getThresholds(), 0, this->width * this->height * sizeof (uint16_t));
+    }
+
+    // updates the free tiles that intersect [x0, x1) x [y0, y1)
+    virtual void update(int* occu, int x0, int y0, int x1, int y1) {
+        for (int ty = this->tileRow[y0]; ty <= this->tileRow[y1 - 1]; ty++) {
+            for (int tx = this->tileColumn[x0]; tx <= this->tileColumn[x1 - 1]; tx++) {
+                if (!isOccupied(occu, tx, ty)) {
+                    updateTile(occu, tx, ty);
+                }
+            }
+        }
+    }
+
+    virtual void update(int* occu) {
+        update(occu, 0, 0, this->width, this->height);
+    }
+
+    virtual void update(uint16_t* depthMap) {
+        setDepthmap(depthMap);
+    }
+
+    // estimates every tile from the background as if it were its first frame
+    virtual void setBackground(const uint16_t* background) {
+        uint16_t* current = getDepthmap();
+        setDepthmap(const_cast<uint16_t*> (background));
+        std::memset(this->residuals, 0, this->blocksX * this->blocksY * sizeof (int16_t));
+        for (int ty = 0; ty < this->numTilesY; ty++) {
+            for (int tx = 0; tx < this->numTilesX; tx++) {
+                this->tiles[ty * this->numTilesX + tx] = TileStatistics();
+                updateTile(NULL, tx, ty);
+            }
+        }
+        setDepthmap(current);
+    }
+
+    /**
+     * Compares every step-th pixel of a tile in the current frame with the
+     * model. The tile is unchanged if at most maxOutliers of the valid samples
+     * deviate by more than k * MAD + minDeviation.
+     */
+    bool isTileUnchanged(int tx, int ty, int step = 4, float k = 3.0f, int minDeviation = 15, float maxOutliers = 0.02f) {
+        const TileStatistics& tile = this->tiles[ty * this->numTilesX + tx];
+        if (!tile.initialized) {
+            return false;
+        }
+
+        const uint16_t* depthMap = getDepthmap();
+        const int limit = (int) (k * tile.mad) + minDeviation;
+        int samples = 0;
+        int outliers = 0;
+        for (int y = tileY0(ty); y < tileY0(ty + 1); y += step) {
+            for (int x = tileX0(tx); x < tileX0(tx + 1); x += step) {
+                int d = depthMap[y * this->width + x];
+                if (d == 0) {
+                    continue;
+                }
+                int diff = d - estimate(x, y);
+                samples++;
+                outliers += (diff > limit || diff < -limit);
+            }
+        }
+        return outliers <= maxOutliers * samples;
+    }
+
+    const TileStatistics& getTileStatistics(int tx, int ty) {
+        return this->tiles[ty * this->numTilesX + tx];
+    }
+
+    // tile statistics followed by the residuals, for the current tiling
+    virtual size_t getStateSize() {
+        return stateSize();
+    }
+
+    virtual void* getState() {
+        return this->state;
+    }
+
+    // bytes of the statistics, without the thresholds of BackgroundModel
+    size_t getMemoryFootprint() {
+        return stateSize() + (this->width + this->height) * sizeof (int);
+    }
+
+    int getNumTilesX() {
+        return this->numTilesX;
+    }
+
+    int getNumTilesY() {
+        return this->numTilesY;
+    }
+};
+
+#endif /* TILEBACKGROUNDMODEL_H */
@@ -0,0 +1,213 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ADAPTIVESEEDING_H
+#define ADAPTIVESEEDING_H
+
+#include <tracker.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+/**
+ * Seed lattice that follows the smallest object to be found and the time
+ * the tracker may take.
+ *
+ * The spacing is the size in pixels of an object of minObjectSize mm at the
+ * far end of the depth range, focalLength * minObjectSize / maxDepth. The
+ * lattice is staggered, odd rows are shifted by half a spacing, and the
+ * whole lattice is moved by a different offset every frame (the additive
+ * R2 sequence, so the offsets cover a lattice cell evenly). A square object
+ * of spacing pixels is hit in every frame; smaller ones are hit within a
+ * few frames.
+ *
+ * Tiles around regions that came close to the spacing are seeded at half
+ * the spacing for holdFrames frames, as further small objects are likely
+ * near them. When a frame takes longer than the budget the spacing grows by
+ * a quarter, up to maxScale times the base spacing, and shrinks back slowly
+ * while frames stay well within the budget.
+ *
+ * Drives the tracker through seed windows; the tracker's own seed grid
+ * should be off, see Tracker::setSeedingPeriod().
+ */
+class AdaptiveSeeding {
+private:
+    int width, height;
+    int tileSize;
+    int tilesX, tilesY;
+    float focalLength;
+    float minObjectSize;
+    float maxDepth;
+    int minSpacing;
+    float scale;
+    float maxScale;
+    double budget;
+    int holdFrames;
+    uint64_t frame;
+    std::vector<int> fine; // frames left per tile
+
+    static int wrap(double value, const int& spacing) {
+        return (int) ((value - std::floor(value)) * spacing);
+    }
+
+    // first lattice coordinate >= from, for a lattice through offset
+    static int first(const int& from, const int& offset, const int& spacing) {
+        return from + ((offset - from) % spacing + spacing) % spacing;
+    }
+
+    template <typename TRACKER> void addLattice(TRACKER& tracker, const int& x0, const int& y0, const int& x1, const int& y1, const int& spacing, const int& offsetX, const int& offsetY) {
+        tracker.addSeedWindow(first(x0, offsetX, spacing), first(y0, offsetY, 2 * spacing), x1, y1, spacing, 2 * spacing);
+        tracker.addSeedWindow(first(x0, offsetX + spacing / 2, spacing), first(y0, offsetY + spacing, 2 * spacing), x1, y1, spacing, 2 * spacing);
+    }
+
+public:
+
+    AdaptiveSeeding(int width, int height, float focalLength = 580.0f, int tileSize = 80) : width(width), height(height), tileSize(tileSize), tilesX((width + tileSize - 1) / tileSize), tilesY((height + tileSize - 1) / tileSize), focalLength(focalLength), minObjectSize(150.0f), maxDepth(4000.0f), minSpacing(4), scale(1.0f), maxScale(4.0f), budget(0), holdFrames(30), frame(0), fine(tilesX * tilesY, 0) {
+    }
+
+    // spacing of the lattice in pixels for the next frame
+    int getSpacing() const {
+        int base = (int) (this->focalLength * this->minObjectSize / this->maxDepth);
+        base = base < this->minSpacing ? this->minSpacing : base;
+        return (int) (base * this->scale);
+    }
+
+    /**
+     * Adds the seed windows for the next frame. contour is the result of the
+     * frame just tracked.
+     */
+    template <typename TRACKER> void apply(TRACKER& tracker, const Contour& contour) {
+        const int spacing = getSpacing();
+
+        for (size_t t = 0; t < this->fine.size(); t++) {
+            this->fine[t] -= this->fine[t] > 0;
+        }
+        for (int l = 0; l < contour.getNumberOfLines(); l++) {
+            const int start = contour.lineStart(l);
+            const int end = contour.lineEnd(l);
+            if (end - start < 3) {
+                continue;
+            }
+            int x0 = contour.getX(start), y0 = contour.getY(start), x1 = x0, y1 = y0;
+            for (int i = start + 1; i < end; i++) {
+                x0 = std::min(x0, contour.getX(i));
+                y0 = std::min(y0, contour.getY(i));
+                x1 = std::max(x1, contour.getX(i));
+                y1 = std::max(y1, contour.getY(i));
+            }
+            if (std::max(x1 - x0, y1 - y0) >= 2 * spacing) {
+                continue;
+            }
+            const int tx0 = std::max(0, (x0 - spacing) / this->tileSize), tx1 = std::min(this->tilesX - 1, (x1 + spacing) / this->tileSize);
+            const int ty0 = std::max(0, (y0 - spacing) / this->tileSize), ty1 = std::min(this->tilesY - 1, (y1 + spacing) / this->tileSize);
+            for (int ty = ty0; ty <= ty1; ty++) {
+                for (int tx = tx0; tx <= tx1; tx++) {
+                    this->fine[ty * this->tilesX + tx] = this->holdFrames;
+                }
+            }
+        }
+
+        this->frame++;
+        const int offsetX = wrap(0.5 + this->frame * 0.7548776662466927, spacing);
+        const int offsetY = wrap(0.5 + this->frame * 0.5698402909980532, 2 * spacing);
+        addLattice(tracker, 0, 0, this->width, this->height, spacing, offsetX, offsetY);
+
+        const int half = spacing / 2 > 0 ? spacing / 2 : 1;
+        for (int ty = 0; ty < this->tilesY; ty++) {
+            for (int tx = 0; tx < this->tilesX; tx++) {
+                if (this->fine[ty * this->tilesX + tx] > 0) {
+                    addLattice(tracker, tx * this->tileSize, ty * this->tileSize, std::min((tx + 1) * this->tileSize, this->width), std::min((ty + 1) * this->tileSize, this->height), half, offsetX, offsetY);
+                }
+            }
+        }
+    }
+
+    /**
+     * Time the last frame took in ms; above the budget the spacing backs off,
+     * below half of it it tightens again. A budget of 0 keeps the spacing.
+     */
+    void reportTime(double ms) {
+        if (this->budget <= 0) {
+            return;
+        }
+        if (ms > this->budget) {
+            this->scale = std::min(this->maxScale, this->scale * 1.25f);
+        } else if (ms < 0.5 * this->budget) {
+            this->scale = std::max(1.0f, this->scale * 0.95f);
+        }
+    }
+
+    // in mm, e.g. the head of a child
+    void setMinObjectSize(float value) {
+        this->minObjectSize = value;
+    }
+
+    float getMinObjectSize() {
+        return this->minObjectSize;
+    }
+
+    // far end of the depth range in mm, e.g. Configuration::maxDistance
+    void setMaxDepth(float value) {
+        this->maxDepth = value > 1 ? value : 1;
+    }
+
+    float getMaxDepth() {
+        return this->maxDepth;
+    }
+
+    void setMinSpacing(int value) {
+        this->minSpacing = value > 0 ? value : 1;
+    }
+
+    int getMinSpacing() {
+        return this->minSpacing;
+    }
+
+    // per frame in ms, 0 turns the back off off
+    void setBudget(double value) {
+        this->budget = value;
+    }
+
+    double getBudget() {
+        return this->budget;
+    }
+
+    void setMaxScale(float value) {
+        this->maxScale = value;
+    }
+
+    float getMaxScale() {
+        return this->maxScale;
+    }
+
+    float getScale() {
+        return this->scale;
+    }
+
+    void setHoldFrames(int value) {
+        this->holdFrames = value;
+    }
+
+    int getHoldFrames() {
+        return this->holdFrames;
+    }
+};
+
+#endif /* ADAPTIVESEEDING_H */
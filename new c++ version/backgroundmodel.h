@@ -38,25 +38,35 @@
 #include <stdint.h>
 #include <iostream>
 #include <cstring>
+#include <vector>
 
 using namespace std;
 
 class BackgroundModel {
 private:
     int width, height;
-    uint16_t* thresholds;
+    uint16_t* thresholds; // written by update()
+    uint16_t* front; // read by getThreshold(), == thresholds unless double buffered
+    uint16_t* allocation; // own thresholds, NULL once others have been adopted
+    uint16_t* backBuffer;
     uint16_t* depthMap;
     int size;
+    std::vector<int> updated; // x0, y0, x1, y1 of the rectangles written since the last swap
+    bool allUpdated; // the whole frame was written since the last swap
 
 public:
 
-    BackgroundModel(uint16_t* depthMap, int width, int height) : width(width), height(height), thresholds(new uint16_t[width*height]), size(width*height) {
+    BackgroundModel(uint16_t* depthMap, int width, int height) : width(width), height(height), thresholds(new uint16_t[width*height]), front(thresholds), allocation(thresholds), backBuffer(NULL), size(width*height), allUpdated(false) {
         std::memset(this->thresholds, 0, width * height * sizeof (uint16_t));
     }
 
     virtual ~BackgroundModel() {
-        if (this->thresholds != NULL) {
-            delete[] this->thresholds;
+        if (this->allocation != NULL) {
+            delete[] this->allocation;
+        }
+
+        if (this->backBuffer != NULL) {
+            delete[] this->backBuffer;
         }
     }
     
@@ -136,13 +146,163 @@ public:
          */
     }
 
+    /**
+     * Updates the rectangle [x0, x1) x [y0, y1) only, used by
+     * BackgroundScheduler to spread the update over several frames.
+     */
+    virtual void update(int* /* occu */, int /* x0 */, int /* y0 */, int /* x1 */, int /* y1 */) {
+    }
+
     int getThreshold(int x, int y) {
-        return this->thresholds[y * width + x];
+        return this->front[y * width + x];
     }
 
     uint16_t* getThresholds() {
         return this->thresholds;
     }
+
+    /**
+     * Starts the model from a background depth map of the same size (0 for
+     * no value), e.g. the surface of Calibration. Models that keep more than
+     * thresholds derive their statistics from it; here it becomes the
+     * thresholds read and written.
+     */
+    virtual void setBackground(const uint16_t* background) {
+        std::memcpy(this->thresholds, background, this->size * sizeof (uint16_t));
+        if (this->front != this->thresholds) {
+            std::memcpy(this->front, background, this->size * sizeof (uint16_t));
+        }
+    }
+
+    /**
+     * Makes the model work on width * height thresholds owned by someone
+     * else, e.g. a mapped BackgroundSnapshot. They have to outlive the model.
+     * Double buffered, update() writes to them and getThreshold() reads a
+     * copy in the back buffer; neither may run meanwhile.
+     */
+    void adoptThresholds(uint16_t* value) {
+        bool doubleBuffered = this->front != this->thresholds;
+        if (this->allocation != NULL) {
+            delete[] this->allocation;
+            this->allocation = NULL;
+        }
+        this->thresholds = value;
+        this->front = value;
+        if (doubleBuffered) {
+            std::memcpy(this->backBuffer, value, this->size * sizeof (uint16_t));
+            this->front = this->backBuffer;
+            this->updated.clear();
+            this->allUpdated = false;
+        }
+    }
+
+    /**
+     * Copies adopted thresholds into memory of the model's own, so whoever
+     * they were adopted from may go away. Does nothing if the model already
+     * owns its thresholds.
+     */
+    void ownThresholds() {
+        if (this->allocation != NULL) {
+            return;
+        }
+        uint16_t* adopted = this->thresholds != this->backBuffer ? this->thresholds : this->front;
+        this->allocation = new uint16_t[this->size];
+        std::memcpy(this->allocation, adopted, this->size * sizeof (uint16_t));
+        if (this->thresholds == adopted) {
+            this->thresholds = this->allocation;
+        }
+        if (this->front == adopted) {
+            this->front = this->allocation;
+        }
+    }
+
+    bool ownsThresholds() {
+        return this->allocation != NULL;
+    }
+
+    /**
+     * Double buffered, update() writes to getThresholds() while
+     * getThreshold() keeps reading the thresholds of the last
+     * swapThresholds(), so the tracker can run on one thread while the
+     * background is updated on another. Enable it after calibration.
+     */
+    void setDoubleBuffered(bool value) {
+        if (value && this->front == this->thresholds) {
+            if (this->backBuffer == NULL) {
+                this->backBuffer = new uint16_t[this->size];
+            }
+            std::memcpy(this->backBuffer, this->thresholds, this->size * sizeof (uint16_t));
+            this->front = this->backBuffer;
+            this->updated.clear();
+            this->allUpdated = false;
+        } else if (!value && this->front != this->thresholds) {
+            this->front = this->thresholds;
+        }
+    }
+
+    bool isDoubleBuffered() {
+        return this->front != this->thresholds;
+    }
+
+    /**
+     * Records that update() wrote [x0, x1) x [y0, y1) of getThresholds(),
+     * see swapThresholds(). Homogeneity and BackgroundScheduler call it for
+     * the updates they run; a model that writes beyond the requested area
+     * marks that part itself.
+     */
+    void markUpdated(int x0, int y0, int x1, int y1) {
+        if (this->front == this->thresholds || this->allUpdated) {
+            return;
+        }
+        if (x0 == 0 && y0 == 0 && x1 == this->width && y1 == this->height) {
+            this->allUpdated = true;
+            this->updated.clear();
+            return;
+        }
+        this->updated.push_back(x0);
+        this->updated.push_back(y0);
+        this->updated.push_back(x1);
+        this->updated.push_back(y1);
+    }
+
+    /**
+     * Makes the updated thresholds the ones getThreshold() reads by swapping
+     * the two buffers. The one update() writes next only has the rectangles
+     * marked since the last swap copied over, so an update spread over many
+     * frames by a BackgroundScheduler copies just what it changed. Neither
+     * update() nor getThreshold() may run meanwhile.
+     */
+    void swapThresholds() {
+        if (this->front != this->thresholds) {
+            uint16_t* written = this->thresholds;
+            this->thresholds = this->front;
+            this->front = written;
+            if (this->allUpdated) {
+                std::memcpy(this->thresholds, this->front, this->size * sizeof (uint16_t));
+            }
+            for (size_t i = 0; i < this->updated.size(); i += 4) {
+                const int x0 = this->updated[i];
+                const int count = this->updated[i + 2] - x0;
+                for (int y = this->updated[i + 1]; y < this->updated[i + 3]; y++) {
+                    std::memcpy(this->thresholds + y * this->width + x0, this->front + y * this->width + x0, count * sizeof (uint16_t));
+                }
+            }
+            this->updated.clear();
+            this->allUpdated = false;
+        }
+    }
+
+    /**
+     * Statistics a model keeps besides its thresholds, as one block of
+     * memory, so that BackgroundSnapshot can save and restore them.
+     */
+    virtual size_t getStateSize() {
+        return 0;
+    }
+
+    virtual void* getState() {
+        return NULL;
+    }
 };
 
 #endif // BACKGROUNDMODEL_H
@@ -0,0 +1,159 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ
+ * email: christ_o@gmx.de
+ *
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BACKGROUNDSCHEDULER_H
+#define BACKGROUNDSCHEDULER_H
+
+#include <cstring>
+
+/**
+ * Spreads the background update over several frames.
+ *
+ * The frame is cut into numTilesX x numTilesY tiles. Every frame the next
+ * tilesPerFrame tiles in round-robin order are updated, so the whole model is
+ * refreshed every numTiles / tilesPerFrame frames. In addition a tile is
+ * updated right away in the frame in which it has been free of occupied
+ * pixels for idleFrames frames in a row, so the background behind someone who
+ * just left catches up without waiting for its turn.
+ *
+ * Whether a tile is free is decided on every sampleSpacing-th pixel of every
+ * sampleSpacing-th row, which makes the check a fraction of a pass over the
+ * frame. A thin region between the samples only lets its tile count as
+ * idle early; the rectangle update itself still skips every occupied pixel.
+ *
+ * Works with every background model that implements the rectangle update
+ * update(occu, x0, y0, x1, y1), see BackgroundModel.
+ */
+class BackgroundScheduler {
+private:
+    int width;
+    int height;
+    int numTilesX;
+    int numTilesY;
+    int numTiles;
+    int tilesPerFrame;
+    int idleFrames;
+    int sampleSpacing;
+    int cursor;
+    int* idle;
+    bool* done;
+
+    void getTile(const int& tile, int* x0, int* y0, int* x1, int* y1) const {
+        int tx = tile % this->numTilesX;
+        int ty = tile / this->numTilesX;
+        *x0 = tx * this->width / this->numTilesX;
+        *x1 = (tx + 1) * this->width / this->numTilesX;
+        *y0 = ty * this->height / this->numTilesY;
+        *y1 = (ty + 1) * this->height / this->numTilesY;
+    }
+
+    bool isOccupied(const int* occu, const int& tile) const {
+        int x0, y0, x1, y1;
+        getTile(tile, &x0, &y0, &x1, &y1);
+        const int s = this->sampleSpacing;
+        for (int y = y0 + (y1 - y0 > s ? s / 2 : 0); y < y1; y += s) {
+            const int* row = occu + y * this->width;
+            for (int x = x0 + (x1 - x0 > s ? s / 2 : 0); x < x1; x += s) {
+                if (row[x] != 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+public:
+
+    BackgroundScheduler(int width, int height, int numTilesX, int numTilesY, int tilesPerFrame, int idleFrames) : width(width), height(height), numTilesX(numTilesX), numTilesY(numTilesY), numTiles(numTilesX * numTilesY), tilesPerFrame(tilesPerFrame), idleFrames(idleFrames), sampleSpacing(4), cursor(0), idle(new int[numTilesX * numTilesY]), done(new bool[numTilesX * numTilesY]) {
+        std::memset(this->idle, 0, this->numTiles * sizeof (int));
+    }
+
+    ~BackgroundScheduler() {
+        if (this->idle != NULL) {
+            delete[] this->idle;
+        }
+
+        if (this->done != NULL) {
+            delete[] this->done;
+        }
+    }
+
+    /**
+     * Runs this frame's share of the background update. The model must have
+     * been given the current depth map already.
+     */
+    template <typename BACKGROUNDMODEL> void update(BACKGROUNDMODEL* model, int* occu) {
+        std::memset(this->done, 0, this->numTiles * sizeof (bool));
+
+        for (int t = 0; t < this->numTiles; t++) {
+            // saturates past idleFrames, so a tile idle for good never wraps around
+            this->idle[t] = isOccupied(occu, t) ? 0 : (this->idle[t] > this->idleFrames ? this->idleFrames + 1 : this->idle[t] + 1);
+            if (this->idle[t] == this->idleFrames) {
+                updateTile(model, occu, t);
+            }
+        }
+
+        int budget = this->tilesPerFrame < this->numTiles ? this->tilesPerFrame : this->numTiles;
+        for (int i = 0; i < budget; i++) {
+            if (!this->done[this->cursor]) {
+                updateTile(model, occu, this->cursor);
+            }
+            this->cursor = (this->cursor + 1) % this->numTiles;
+        }
+    }
+
+    template <typename BACKGROUNDMODEL> void updateTile(BACKGROUNDMODEL* model, int* occu, const int& tile) {
+        int x0, y0, x1, y1;
+        getTile(tile, &x0, &y0, &x1, &y1);
+        model->update(occu, x0, y0, x1, y1);
+        model->markUpdated(x0, y0, x1, y1);
+        this->done[tile] = true;
+    }
+
+    void setTilesPerFrame(int value) {
+        this->tilesPerFrame = value;
+    }
+
+    int getTilesPerFrame() {
+        return this->tilesPerFrame;
+    }
+
+    void setIdleFrames(int value) {
+        this->idleFrames = value;
+    }
+
+    int getIdleFrames() {
+        return this->idleFrames;
+    }
+
+    // 1 checks every pixel of a tile
+    void setSampleSpacing(int value) {
+        this->sampleSpacing = value > 0 ? value : 1;
+    }
+
+    int getSampleSpacing() {
+        return this->sampleSpacing;
+    }
+
+    int getNumberOfTiles() {
+        return this->numTiles;
+    }
+};
+
+#endif /* BACKGROUNDSCHEDULER_H */
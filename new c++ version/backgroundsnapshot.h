@@ -0,0 +1,257 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BACKGROUNDSNAPSHOT_H
+#define BACKGROUNDSNAPSHOT_H
+
+#include <backgroundmodel.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+class BackgroundSnapshotHeader {
+public:
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    int32_t width;
+    int32_t height;
+    char sensorId[64];
+    uint64_t thresholdsOffset;
+    uint64_t thresholdsSize;
+    uint64_t stateOffset;
+    uint64_t stateSize;
+    uint64_t checksum; // over thresholds and state
+};
+
+/**
+ * Saves a background model to a file and maps it back in on start up.
+ *
+ * The file is a BackgroundSnapshotHeader followed by the thresholds, which
+ * start on a page boundary, and the model's state (see
+ * BackgroundModel::getStateSize()). load() maps the file privately and hands
+ * the mapped thresholds to the model with adoptThresholds(), so nothing is
+ * copied; pages the model writes to later are copied by the kernel. The
+ * state is small compared to the thresholds' page cache and is copied into
+ * the model.
+ *
+ * The snapshot owns the mapping. release(), the destructor and a later
+ * load() hand the thresholds back to the model (BackgroundModel::
+ * ownThresholds()) before the mapping goes away, so the model has to outlive
+ * the snapshot or the snapshot has to be released first. Resolution, sensor
+ * id and checksum are checked before anything is handed to the model; on
+ * failure the model and an earlier mapping are left untouched and the
+ * caller falls back to Calibration.
+ */
+class BackgroundSnapshot {
+private:
+    static const uint32_t VERSION = 1;
+    static const size_t PAGE = 4096;
+
+    void* mapping;
+    size_t mappingSize;
+    BackgroundModel* model; // the model the mapped thresholds were handed to
+
+    static size_t align(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Fletcher-64 over 32 bit words, a short tail is padded with zeros
+    static void checksum(const void* data, const size_t& size, uint64_t* sum1, uint64_t* sum2) {
+        const uint8_t* bytes = (const uint8_t*) data;
+        size_t words = size / 4;
+        uint64_t a = *sum1, b = *sum2;
+        for (size_t i = 0; i < words; i++) {
+            uint32_t word;
+            std::memcpy(&word, bytes + 4 * i, 4);
+            a = (a + word) % 0xFFFFFFFFull;
+            b = (b + a) % 0xFFFFFFFFull;
+        }
+        if (size % 4 != 0) {
+            uint32_t word = 0;
+            std::memcpy(&word, bytes + 4 * words, size % 4);
+            a = (a + word) % 0xFFFFFFFFull;
+            b = (b + a) % 0xFFFFFFFFull;
+        }
+        *sum1 = a;
+        *sum2 = b;
+    }
+
+    static uint64_t checksum(const void* thresholds, const size_t& thresholdsSize, const void* state, const size_t& stateSize) {
+        uint64_t a = 0, b = 0;
+        checksum(thresholds, thresholdsSize, &a, &b);
+        checksum(state, stateSize, &a, &b);
+        return (b << 32) | a;
+    }
+
+    static bool write(FILE* file, const void* data, const size_t& size) {
+        return size == 0 || std::fwrite(data, 1, size, file) == size;
+    }
+
+    static bool pad(FILE* file, size_t size) {
+        static const char zeros[64] = {0};
+        while (size > 0) {
+            size_t n = size < sizeof (zeros) ? size : sizeof (zeros);
+            if (!write(file, zeros, n)) {
+                return false;
+            }
+            size -= n;
+        }
+        return true;
+    }
+
+public:
+
+    BackgroundSnapshot() : mapping(NULL), mappingSize(0), model(NULL) {
+    }
+
+    ~BackgroundSnapshot() {
+        release();
+    }
+
+    /**
+     * Writes thresholds and state of model. The file is written next to
+     * filename and renamed over it, so a crash never leaves a torn snapshot.
+     */
+    static bool save(const char* filename, BackgroundModel* model, const char* sensorId) {
+        BackgroundSnapshotHeader header;
+        std::memset(&header, 0, sizeof (header));
+        std::memcpy(header.magic, "TBGSNAP", 8);
+        header.version = VERSION;
+        header.headerSize = sizeof (header);
+        header.width = model->getWidth();
+        header.height = model->getHeight();
+        std::strncpy(header.sensorId, sensorId, sizeof (header.sensorId) - 1);
+        header.thresholdsOffset = align(sizeof (header), PAGE);
+        header.thresholdsSize = (uint64_t) header.width * header.height * sizeof (uint16_t);
+        header.stateOffset = align(header.thresholdsOffset + header.thresholdsSize, 8);
+        header.stateSize = model->getStateSize();
+        header.checksum = checksum(model->getThresholds(), header.thresholdsSize, model->getState(), header.stateSize);
+
+        std::string temporary = std::string(filename) + ".tmp";
+        FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (file == NULL) {
+            return false;
+        }
+
+        bool ok = write(file, &header, sizeof (header))
+                && pad(file, header.thresholdsOffset - sizeof (header))
+                && write(file, model->getThresholds(), header.thresholdsSize)
+                && pad(file, header.stateOffset - header.thresholdsOffset - header.thresholdsSize)
+                && write(file, model->getState(), header.stateSize)
+                && std::fflush(file) == 0
+                && fsync(fileno(file)) == 0;
+        ok = std::fclose(file) == 0 && ok;
+
+        if (!ok || std::rename(temporary.c_str(), filename) != 0) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Maps filename and restores model from it if resolution and sensor id
+     * match. verify == false skips the checksum, which reads the whole file.
+     */
+    bool load(const char* filename, BackgroundModel* model, const char* sensorId, bool verify = true) {
+        int fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof (BackgroundSnapshotHeader)) {
+            close(fd);
+            return false;
+        }
+
+        // private and writable: the model updates the thresholds in place
+        size_t size = info.st_size;
+        void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+
+        const BackgroundSnapshotHeader* header = (const BackgroundSnapshotHeader*) data;
+        bool ok = std::memcmp(header->magic, "TBGSNAP", 8) == 0
+                && header->version == VERSION
+                && header->headerSize == sizeof (BackgroundSnapshotHeader)
+                && header->width == model->getWidth()
+                && header->height == model->getHeight()
+                && std::strncmp(header->sensorId, sensorId, sizeof (header->sensorId)) == 0
+                && header->thresholdsOffset % PAGE == 0
+                && header->thresholdsSize == (uint64_t) model->getWidth() * model->getHeight() * sizeof (uint16_t)
+                && header->thresholdsOffset + header->thresholdsSize <= size
+                && header->stateSize == model->getStateSize()
+                && header->stateOffset + header->stateSize <= size;
+
+        uint8_t* bytes = (uint8_t*) data;
+        if (ok && verify) {
+            ok = header->checksum == checksum(bytes + header->thresholdsOffset, header->thresholdsSize, bytes + header->stateOffset, header->stateSize);
+        }
+        if (!ok) {
+            munmap(data, size);
+            return false;
+        }
+
+        madvise(bytes + header->thresholdsOffset, header->thresholdsSize, MADV_WILLNEED);
+        if (header->stateSize > 0) {
+            std::memcpy(model->getState(), bytes + header->stateOffset, header->stateSize);
+        }
+        // the same model lets go of the old mapping by adopting the new one
+        if (this->model != model) {
+            release();
+        }
+        void* previous = this->mapping;
+        size_t previousSize = this->mappingSize;
+        model->adoptThresholds((uint16_t*) (bytes + header->thresholdsOffset));
+        if (previous != NULL) {
+            munmap(previous, previousSize);
+        }
+
+        this->mapping = data;
+        this->mappingSize = size;
+        this->model = model;
+        return true;
+    }
+
+    bool isLoaded() {
+        return this->mapping != NULL;
+    }
+
+    // the model gets a copy of the thresholds it adopted, then the file is unmapped
+    void release() {
+        if (this->mapping != NULL) {
+            this->model->ownThresholds();
+            munmap(this->mapping, this->mappingSize);
+            this->mapping = NULL;
+            this->mappingSize = 0;
+            this->model = NULL;
+        }
+    }
+};
+
+#endif /* BACKGROUNDSNAPSHOT_H */
@@ -31,6 +31,13 @@
 #define TRIM_CONTOUR_LENGTH  4096
 #define N_LONGEST_CONTOURS  0
 #define SAMPLE_RATE                     1024
+#define MAX_RESAMPLED_CONTOURS  64
+#define BACKGROUND_TILES_PER_FRAME  0
+#define BACKGROUND_IDLE_FRAMES  10
+#define TRACKER_NUM_THREADS  1
+#define TRACKER_SEEDING_PERIOD  1
+#define TRACKER_MIN_OBJECT_SIZE  150
+#define TRACKER_FOCAL_LENGTH  580
 
 class Configuration {
 private:
@@ -51,7 +58,20 @@ public:
     int tracker_min_contour_length;
     int tracker_trim_contour_length;
     int tracker_n_longest_contours;
+    int tracker_num_threads; // > 1 grows regions in parallel
+    int tracker_seeding_period; // frames in which the whole seed grid is scanned once
+    bool tracker_track_ids; // keeps the ids of the regions across frames, see TrackAssociator
+    bool tracker_motion_seeding; // seeds densely around the predicted regions, implies tracker_track_ids
+    bool tracker_adaptive_seeding; // replaces the seed grid by AdaptiveSeeding
+    float tracker_min_object_size; // mm, at maxDistance
+    float tracker_focal_length; // pixels
+    double tracker_frame_budget_ms; // 0 never backs off
+    double tracker_deadline_ms; // > 0 stops growing and tracing after that long, see Tracker::track(deadline)
     double samplerate;
+    int max_resampled_contours;
+    bool background_update; // TrackingHelper::process() updates the background from every complete frame
+    int background_tiles_per_frame; // 0 updates the whole background every frame
+    int background_idle_frames;
     int minDistance = 300;
     int maxDistance = 1300;
     int thresholdOffset = 40;
@@ -69,7 +89,20 @@ public:
     tracker_min_contour_length(MIN_CONTOUR_LENGTH),
     tracker_trim_contour_length(TRIM_CONTOUR_LENGTH),
     tracker_n_longest_contours(N_LONGEST_CONTOURS),
-    samplerate(SAMPLE_RATE) {
+    tracker_num_threads(TRACKER_NUM_THREADS),
+    tracker_seeding_period(TRACKER_SEEDING_PERIOD),
+    tracker_track_ids(false),
+    tracker_motion_seeding(false),
+    tracker_adaptive_seeding(false),
+    tracker_min_object_size(TRACKER_MIN_OBJECT_SIZE),
+    tracker_focal_length(TRACKER_FOCAL_LENGTH),
+    tracker_frame_budget_ms(0),
+    tracker_deadline_ms(0),
+    samplerate(SAMPLE_RATE),
+    max_resampled_contours(MAX_RESAMPLED_CONTOURS),
+    background_update(false),
+    background_tiles_per_frame(BACKGROUND_TILES_PER_FRAME),
+    background_idle_frames(BACKGROUND_IDLE_FRAMES) {
     }
 
     ~Configuration() {
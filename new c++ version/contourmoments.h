@@ -0,0 +1,199 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ
+ * email: christ_o@gmx.de
+ *
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTOURMOMENTS_H
+#define CONTOURMOMENTS_H
+
+#include <tracker.h>
+#include <stdint.h>
+#include <cmath>
+
+/**
+ * Area moments of the region enclosed by one contour line.
+ *
+ * All values describe the enclosed pixels, i.e. they are the same for an
+ * outer boundary and for a hole of the same shape; hole tells which one it is.
+ * Centroid and central moments are those of the pixel centers, so they match
+ * a raster computation over the region mask.
+ */
+class RegionMoments {
+public:
+    int64_t signedArea; // > 0 for outer boundaries, < 0 for holes
+    bool hole;
+    int64_t area;
+    double cx;
+    double cy;
+    // central moments
+    double mu20;
+    double mu11;
+    double mu02;
+    double mu30;
+    double mu21;
+    double mu12;
+    double mu03;
+    double hu[7];
+
+    RegionMoments() : signedArea(0), hole(false), area(0), cx(0), cy(0), mu20(0), mu11(0), mu02(0), mu30(0), mu21(0), mu12(0), mu03(0) {
+        for (int i = 0; i < 7; i++) {
+            hu[i] = 0;
+        }
+    }
+
+    // orientation of the major axis in radians
+    double getOrientation() const {
+        return 0.5 * std::atan2(2.0 * mu11, mu20 - mu02);
+    }
+};
+
+/**
+ * Exact area moments of contour lines by the discrete Green's theorem.
+ *
+ * A contour line as traced by Tracker::makeContour() is a closed polygon on
+ * the pixel corner grid, so area, centroid, second and third order moments
+ * follow from sums over its edges, O(perimeter), without touching the
+ * interior. Sums are kept in 64 bit integers relative to the first point of
+ * the line, which keeps them exact for any frame size.
+ *
+ * makeContour() walks outer boundaries with the region on one side and holes
+ * the other way round, so the sign of the area separates the two.
+ */
+class ContourMoments {
+public:
+
+    void compute(const Contour& contour, const int& start, const int& end, RegionMoments& m) {
+        m = RegionMoments();
+        if (end - start < 3) {
+            return;
+        }
+
+        const int ox = contour.getX(start);
+        const int oy = contour.getY(start);
+
+        int64_t a = 0;
+        int64_t sx = 0, sy = 0;
+        int64_t sxx = 0, sxy = 0, syy = 0;
+        int64_t sxxx = 0, sxxy = 0, sxyy = 0, syyy = 0;
+
+        int64_t x0 = 0;
+        int64_t y0 = 0;
+        for (int i = start + 1; i <= end; i++) {
+            // the last edge closes the line back to its first point
+            int j = i < end ? i : start;
+            int64_t x1 = contour.getX(j) - ox;
+            int64_t y1 = contour.getY(j) - oy;
+
+            // image y points down, flip so that outer boundaries count positive
+            int64_t c = x1 * y0 - x0 * y1;
+            a += c;
+            sx += (x0 + x1) * c;
+            sy += (y0 + y1) * c;
+            sxx += (x0 * x0 + x0 * x1 + x1 * x1) * c;
+            syy += (y0 * y0 + y0 * y1 + y1 * y1) * c;
+            sxy += (x0 * y1 + 2 * x0 * y0 + 2 * x1 * y1 + x1 * y0) * c;
+            sxxx += (x0 * x0 * x0 + x0 * x0 * x1 + x0 * x1 * x1 + x1 * x1 * x1) * c;
+            syyy += (y0 * y0 * y0 + y0 * y0 * y1 + y0 * y1 * y1 + y1 * y1 * y1) * c;
+            sxxy += (x0 * x0 * (3 * y0 + y1) + 2 * x0 * x1 * (y0 + y1) + x1 * x1 * (y0 + 3 * y1)) * c;
+            sxyy += (y0 * y0 * (3 * x0 + x1) + 2 * y0 * y1 * (x0 + x1) + y1 * y1 * (x0 + 3 * x1)) * c;
+
+            x0 = x1;
+            y0 = y1;
+        }
+
+        // a is twice the signed area
+        m.signedArea = a / 2;
+        m.hole = a < 0;
+        if (a == 0) {
+            return;
+        }
+
+        double s = a < 0 ? -1.0 : 1.0;
+        double m00 = s * a / 2.0;
+        double m10 = s * sx / 6.0;
+        double m01 = s * sy / 6.0;
+        double m20 = s * sxx / 12.0;
+        double m02 = s * syy / 12.0;
+        double m11 = s * sxy / 24.0;
+        double m30 = s * sxxx / 20.0;
+        double m03 = s * syyy / 20.0;
+        double m21 = s * sxxy / 60.0;
+        double m12 = s * sxyy / 60.0;
+
+        double xc = m10 / m00;
+        double yc = m01 / m00;
+
+        m.area = a < 0 ? -a / 2 : a / 2;
+        // pixel (x, y) covers the square [x, x + 1) x [y, y + 1)
+        m.cx = ox + xc - 0.5;
+        m.cy = oy + yc - 0.5;
+
+        // the polygon integrals cover each pixel as a unit square, the discrete
+        // moments of the pixel centers differ from them by 1/12 per pixel
+        m.mu20 = m20 - xc * m10 - m00 / 12.0;
+        m.mu02 = m02 - yc * m01 - m00 / 12.0;
+        m.mu11 = m11 - xc * m01;
+        m.mu30 = m30 - 3 * xc * m20 + 2 * xc * xc * m10;
+        m.mu03 = m03 - 3 * yc * m02 + 2 * yc * yc * m01;
+        m.mu21 = m21 - 2 * xc * m11 - yc * m20 + 2 * xc * xc * m01;
+        m.mu12 = m12 - 2 * yc * m11 - xc * m02 + 2 * yc * yc * m10;
+
+        computeHu(m00, m);
+    }
+
+    /**
+     * Moments of all lines of a contour. out must hold
+     * contour.getNumberOfLines() entries.
+     */
+    void computeAll(const Contour& contour, RegionMoments* out) {
+        for (int i = 0; i < contour.getNumberOfLines(); i++) {
+            compute(contour, contour.lineStart(i), contour.lineEnd(i), out[i]);
+        }
+    }
+
+private:
+
+    void computeHu(const double& m00, RegionMoments& m) {
+        double n2 = m00 * m00;
+        double n3 = n2 * std::sqrt(m00);
+
+        double n20 = m.mu20 / n2;
+        double n02 = m.mu02 / n2;
+        double n11 = m.mu11 / n2;
+        double n30 = m.mu30 / n3;
+        double n03 = m.mu03 / n3;
+        double n21 = m.mu21 / n3;
+        double n12 = m.mu12 / n3;
+
+        double t0 = n30 + n12;
+        double t1 = n21 + n03;
+        double q0 = t0 * t0;
+        double q1 = t1 * t1;
+        double d0 = n30 - 3 * n12;
+        double d1 = 3 * n21 - n03;
+
+        m.hu[0] = n20 + n02;
+        m.hu[1] = (n20 - n02) * (n20 - n02) + 4 * n11 * n11;
+        m.hu[2] = d0 * d0 + d1 * d1;
+        m.hu[3] = q0 + q1;
+        m.hu[4] = d0 * t0 * (q0 - 3 * q1) + d1 * t1 * (3 * q0 - q1);
+        m.hu[5] = (n20 - n02) * (q0 - q1) + 4 * n11 * t0 * t1;
+        m.hu[6] = d1 * t0 * (q0 - 3 * q1) - d0 * t1 * (3 * q0 - q1);
+    }
+};
+
+#endif /* CONTOURMOMENTS_H */
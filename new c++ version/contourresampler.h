@@ -0,0 +1,214 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ
+ * email: christ_o@gmx.de
+ *
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTOURRESAMPLER_H
+#define CONTOURRESAMPLER_H
+
+#include <tracker.h>
+#include <cmath>
+
+/**
+ * Fixed size buffer of resampled contour lines.
+ *
+ * Every line holds exactly getSampleRate() points, stored as separate x and y
+ * arrays; line i starts at i * getSampleRate(). getSourceLine() maps a line
+ * back to the line of the Contour it was sampled from. Lines offered beyond
+ * getMaxLines() are dropped and counted by getSkippedLines().
+ */
+class ResampledContours {
+private:
+    int samplerate;
+    int maxLines;
+    int linecount;
+    int skipped;
+    float* x;
+    float* y;
+    int* sourceLines;
+
+public:
+
+    ResampledContours(int samplerate, int maxLines) : samplerate(samplerate), maxLines(maxLines), linecount(0), skipped(0), x(new float[samplerate * maxLines]), y(new float[samplerate * maxLines]), sourceLines(new int[maxLines]) {
+    }
+
+    ~ResampledContours() {
+        if (this->x != NULL) {
+            delete[] this->x;
+        }
+
+        if (this->y != NULL) {
+            delete[] this->y;
+        }
+
+        if (this->sourceLines != NULL) {
+            delete[] this->sourceLines;
+        }
+    }
+
+    void clear() {
+        this->linecount = 0;
+        this->skipped = 0;
+    }
+
+    // reserves the next line, returns its index or -1 when the buffer is full
+    int addLine(const int& sourceLine) {
+        if (this->linecount >= this->maxLines) {
+            this->skipped++;
+            return -1;
+        }
+        this->sourceLines[this->linecount] = sourceLine;
+        return this->linecount++;
+    }
+
+    const int& getSampleRate() const {
+        return this->samplerate;
+    }
+
+    const int& getMaxLines() const {
+        return this->maxLines;
+    }
+
+    const int& getNumberOfLines() const {
+        return this->linecount;
+    }
+
+    // lines that did not fit since the last clear()
+    const int& getSkippedLines() const {
+        return this->skipped;
+    }
+
+    const int& getSourceLine(const int& index) const {
+        return this->sourceLines[index];
+    }
+
+    float* getX(const int& line) {
+        return this->x + line * this->samplerate;
+    }
+
+    float* getY(const int& line) {
+        return this->y + line * this->samplerate;
+    }
+
+    const float* getX(const int& line) const {
+        return this->x + line * this->samplerate;
+    }
+
+    const float* getY(const int& line) const {
+        return this->y + line * this->samplerate;
+    }
+};
+
+/**
+ * Arc-length uniform resampling of contour lines.
+ *
+ * Each selected line is treated as a closed polygon and sampled at
+ * getSampleRate() points spaced evenly along its perimeter, starting at its
+ * first point. Works on raw contours as well as on the output of
+ * ContourSimplifier. Lines are independent, so with OpenMP enabled they are
+ * sampled in parallel.
+ */
+class ContourResampler {
+private:
+    int minLength;
+
+    static void resampleLine(const Contour& in, const int& start, const int& end, float* outX, float* outY, const int& samplerate) {
+        int n = end - start;
+
+        double perimeter = 0;
+        for (int i = 0; i < n; i++) {
+            int j = start + (i + 1 < n ? i + 1 : 0);
+            double dx = in.getX(j) - in.getX(start + i);
+            double dy = in.getY(j) - in.getY(start + i);
+            perimeter += std::sqrt(dx * dx + dy * dy);
+        }
+
+        if (perimeter <= 0) {
+            for (int k = 0; k < samplerate; k++) {
+                outX[k] = in.getX(start);
+                outY[k] = in.getY(start);
+            }
+            return;
+        }
+
+        double step = perimeter / samplerate;
+        double walked = 0; // arc length at the start of the current segment
+        int i = 0;
+        double x0 = in.getX(start);
+        double y0 = in.getY(start);
+        int j = start + (n > 1 ? 1 : 0);
+        double segX = in.getX(j) - x0;
+        double segY = in.getY(j) - y0;
+        double segLength = std::sqrt(segX * segX + segY * segY);
+
+        for (int k = 0; k < samplerate; k++) {
+            double target = k * step;
+            while (walked + segLength < target && i < n - 1) {
+                walked += segLength;
+                i++;
+                x0 = in.getX(start + i);
+                y0 = in.getY(start + i);
+                j = start + (i + 1 < n ? i + 1 : 0);
+                segX = in.getX(j) - x0;
+                segY = in.getY(j) - y0;
+                segLength = std::sqrt(segX * segX + segY * segY);
+            }
+            double t = segLength > 0 ? (target - walked) / segLength : 0;
+            outX[k] = (float) (x0 + t * segX);
+            outY[k] = (float) (y0 + t * segY);
+        }
+    }
+
+public:
+
+    ContourResampler(int minLength = 0) : minLength(minLength) {
+    }
+
+    void setMinLength(int value) {
+        this->minLength = value;
+    }
+
+    int getMinLength() {
+        return this->minLength;
+    }
+
+    /**
+     * Resamples all lines with at least getMinLength() points, up to the
+     * capacity of out. Returns the number of lines written; the ones that
+     * did not fit are counted by out.getSkippedLines().
+     */
+    int resample(const Contour& in, ResampledContours& out) {
+        out.clear();
+        for (int l = 0; l < in.getNumberOfLines(); l++) {
+            if (in.lineEnd(l) - in.lineStart(l) >= this->minLength && in.lineEnd(l) > in.lineStart(l)) {
+                out.addLine(l);
+            }
+        }
+
+        const int lines = out.getNumberOfLines();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int i = 0; i < lines; i++) {
+            int l = out.getSourceLine(i);
+            resampleLine(in, in.lineStart(l), in.lineEnd(l), out.getX(i), out.getY(i), out.getSampleRate());
+        }
+        return lines;
+    }
+};
+
+#endif /* CONTOURRESAMPLER_H */
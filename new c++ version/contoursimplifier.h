@@ -0,0 +1,228 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ
+ * email: christ_o@gmx.de
+ *
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTOURSIMPLIFIER_H
+#define CONTOURSIMPLIFIER_H
+
+#include <tracker.h>
+#include <stdint.h>
+
+/**
+ * Reduces contour lines to their corner vertices.
+ *
+ * makeContour() emits one point per unit step along the boundary. compress()
+ * drops every point that lies on a straight run, which is lossless: the
+ * polygon through the remaining corners is the same polygon. simplify()
+ * additionally runs Douglas-Peucker on the corners, dropping vertices that are
+ * closer than a tolerance to the simplified line.
+ *
+ * Lines are treated as closed. The duplicated closing point that makeContour()
+ * appends is removed, so an output line holds every corner exactly once. The
+ * output is a Contour of its own; it needs at least the capacity of the input.
+ */
+class ContourSimplifier {
+private:
+    int size;
+    int* cornerX;
+    int* cornerY;
+    bool* keep;
+    int* stack;
+
+    static bool isCorner(const int& ax, const int& ay, const int& bx, const int& by, const int& cx, const int& cy) {
+        int64_t ux = bx - ax;
+        int64_t uy = by - ay;
+        int64_t vx = cx - bx;
+        int64_t vy = cy - by;
+        if (ux == 0 && uy == 0) {
+            return false;
+        }
+        // b is redundant if the path keeps going in the same direction
+        return ux * vy - uy * vx != 0 || ux * vx + uy * vy < 0;
+    }
+
+    int findCorners(const Contour& in, const int& start, const int& end) {
+        int n = end - start;
+        if (n > 1 && in.getX(start) == in.getX(end - 1) && in.getY(start) == in.getY(end - 1)) {
+            n--;
+        }
+        if (n < 3) {
+            for (int i = 0; i < n; i++) {
+                this->cornerX[i] = in.getX(start + i);
+                this->cornerY[i] = in.getY(start + i);
+            }
+            return n;
+        }
+
+        int count = 0;
+        int prev = start + n - 1;
+        for (int i = 0; i < n; i++) {
+            int curr = start + i;
+            int next = start + (i + 1 < n ? i + 1 : 0);
+            if (isCorner(in.getX(prev), in.getY(prev), in.getX(curr), in.getY(curr), in.getX(next), in.getY(next))) {
+                this->cornerX[count] = in.getX(curr);
+                this->cornerY[count] = in.getY(curr);
+                count++;
+                prev = curr;
+            }
+        }
+        return count;
+    }
+
+    // Douglas-Peucker on the chain of corners [first, last], index count
+    // stands for the first corner again
+    void reduce(const int& first, const int& last, const int& count, const double& tolerance) {
+        double tolerance2 = tolerance * tolerance;
+        int top = 0;
+        this->stack[top++] = first;
+        this->stack[top++] = last;
+
+        while (top > 0) {
+            int b = this->stack[--top];
+            int a = this->stack[--top];
+            if (b - a < 2) {
+                continue;
+            }
+
+            int bi = b < count ? b : 0;
+            double ax = this->cornerX[a];
+            double ay = this->cornerY[a];
+            double dx = this->cornerX[bi] - ax;
+            double dy = this->cornerY[bi] - ay;
+            double length2 = dx * dx + dy * dy;
+
+            int farthest = -1;
+            double farthestDistance = 0;
+            for (int i = a + 1; i < b; i++) {
+                double px = this->cornerX[i] - ax;
+                double py = this->cornerY[i] - ay;
+                double cross = dx * py - dy * px;
+                // squared distance to the line scaled by length2
+                double d = length2 > 0 ? cross * cross : (px * px + py * py);
+                if (d > farthestDistance) {
+                    farthestDistance = d;
+                    farthest = i;
+                }
+            }
+
+            double limit = length2 > 0 ? tolerance2 * length2 : tolerance2;
+            if (farthest >= 0 && farthestDistance > limit) {
+                this->keep[farthest] = true;
+                this->stack[top++] = a;
+                this->stack[top++] = farthest;
+                this->stack[top++] = farthest;
+                this->stack[top++] = b;
+            }
+        }
+    }
+
+    void emitLine(Contour& out, const int& count) {
+        for (int i = 0; i < count; i++) {
+            if (this->keep[i]) {
+                out.push(this->cornerX[i], this->cornerY[i]);
+            }
+        }
+        out.addLine();
+    }
+
+public:
+
+    ContourSimplifier(int size) : size(size), cornerX(new int[size]), cornerY(new int[size]), keep(new bool[size + 1]), stack(new int[4 * size + 4]) {
+    }
+
+    ~ContourSimplifier() {
+        if (this->cornerX != NULL) {
+            delete[] this->cornerX;
+        }
+
+        if (this->cornerY != NULL) {
+            delete[] this->cornerY;
+        }
+
+        if (this->keep != NULL) {
+            delete[] this->keep;
+        }
+
+        if (this->stack != NULL) {
+            delete[] this->stack;
+        }
+    }
+
+    /**
+     * Lossless: keeps only the corners of each line.
+     */
+    void compress(const Contour& in, Contour& out) {
+        out.clear();
+        for (int l = 0; l < in.getNumberOfLines(); l++) {
+            int count = findCorners(in, in.lineStart(l), in.lineEnd(l));
+            for (int i = 0; i < count; i++) {
+                this->keep[i] = true;
+            }
+            emitLine(out, count);
+        }
+    }
+
+    /**
+     * Corners followed by Douglas-Peucker with the given tolerance in pixels.
+     * A tolerance of 0 is the same as compress().
+     */
+    void simplify(const Contour& in, Contour& out, const double& tolerance) {
+        out.clear();
+        for (int l = 0; l < in.getNumberOfLines(); l++) {
+            int count = findCorners(in, in.lineStart(l), in.lineEnd(l));
+
+            if (tolerance <= 0 || count <= 3) {
+                for (int i = 0; i < count; i++) {
+                    this->keep[i] = true;
+                }
+                emitLine(out, count);
+                continue;
+            }
+
+            for (int i = 0; i < count; i++) {
+                this->keep[i] = false;
+            }
+
+            // split the closed line at its first corner and the corner
+            // farthest away from it, then reduce both halves
+            int split = 1;
+            int64_t splitDistance = 0;
+            for (int i = 1; i < count; i++) {
+                int64_t dx = this->cornerX[i] - this->cornerX[0];
+                int64_t dy = this->cornerY[i] - this->cornerY[0];
+                if (dx * dx + dy * dy > splitDistance) {
+                    splitDistance = dx * dx + dy * dy;
+                    split = i;
+                }
+            }
+            this->keep[0] = true;
+            this->keep[split] = true;
+
+            reduce(0, split, count, tolerance);
+            reduce(split, count, count, tolerance);
+
+            emitLine(out, count);
+        }
+    }
+
+    int getSize() {
+        return this->size;
+    }
+};
+
+#endif /* CONTOURSIMPLIFIER_H */
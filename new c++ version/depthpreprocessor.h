@@ -0,0 +1,221 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DEPTHPREPROCESSOR_H
+#define DEPTHPREPROCESSOR_H
+
+#include <stdint.h>
+#include <cstring>
+
+/**
+ * Turns a sensor frame into the uint16_t depth map (mm, 0 == no value) the
+ * tracker works on, in a single pass over the frame.
+ *
+ * Per pixel the input is converted to mm (float input is multiplied by
+ * getScale() and saturated to [0, 65535], NaN becomes 0; raw Kinect
+ * disparity is looked up in a DisparityLUT table), multiplied by the
+ * ROI mask (0 or 1 per pixel, as made by TrackingHelper::convertTo16Bit) and,
+ * with hole filling on, a pixel without value inside the mask gets the mean
+ * of its valid 3x3 neighbours if it has at least getMinNeighbours() of them.
+ *
+ * For hole filling the converted rows go through a ring of three rows that
+ * stays in cache, and a row is written out once the row below it has been
+ * converted. So every input pixel is read once and every output pixel is
+ * written once. All row loops are branch-free and vectorize.
+ */
+class DepthPreprocessor {
+private:
+    int width;
+    int height;
+    float scale;
+    const uint16_t* disparityTable;
+    const uint16_t* mask;
+    bool fillHoles;
+    int minNeighbours;
+    uint16_t* ring; // 3 rows of width + 2, zero in the first and last column
+    uint16_t* ones;
+
+    void convertRow(const float* in, const uint16_t* mask, uint16_t* out) const {
+        convert(in, out, this->width, this->scale);
+        applyMask(mask, out);
+    }
+
+    void convertRow(const uint16_t* in, const uint16_t* mask, uint16_t* out) const {
+        if (this->disparityTable != NULL) {
+            const uint16_t* table = this->disparityTable;
+            for (int x = 0; x < this->width; x++) {
+                out[x] = table[in[x] & 2047];
+            }
+        } else {
+            std::memcpy(out, in, this->width * sizeof (uint16_t));
+        }
+        applyMask(mask, out);
+    }
+
+    void applyMask(const uint16_t* mask, uint16_t* out) const {
+        if (mask != NULL) {
+            for (int x = 0; x < this->width; x++) {
+                out[x] *= mask[x];
+            }
+        }
+    }
+
+    uint16_t* ringRow(const int& y) const {
+        return this->ring + (y % 3) * (this->width + 2) + 1;
+    }
+
+    // fills the holes of row center into out; above, below and mask may be NULL
+    void fillRow(const uint16_t* above, const uint16_t* center, const uint16_t* below, const uint16_t* mask, uint16_t* out) const {
+        const int w = this->width;
+        const int minimum = this->minNeighbours;
+        const uint16_t* zeros = this->ring + 3 * (w + 2) + 1;
+        const uint16_t* a = above != NULL ? above : zeros;
+        const uint16_t* b = below != NULL ? below : zeros;
+        const uint16_t* m = mask != NULL ? mask : this->ones;
+
+        for (int x = 0; x < w; x++) {
+            uint32_t sum = a[x - 1] + a[x] + a[x + 1] + center[x - 1] + center[x + 1] + b[x - 1] + b[x] + b[x + 1];
+            int count = (a[x - 1] != 0) + (a[x] != 0) + (a[x + 1] != 0) + (center[x - 1] != 0) + (center[x + 1] != 0) + (b[x - 1] != 0) + (b[x] != 0) + (b[x + 1] != 0);
+            float mean = (float) sum / (float) (count + (count == 0)) + 0.5f;
+            int filled = (int) mean * (count >= minimum) * m[x];
+            out[x] = (uint16_t) (center[x] + (center[x] == 0) * filled);
+        }
+    }
+
+    template <typename T> void run(const T* in, uint16_t* out) {
+        const int w = this->width;
+        if (!this->fillHoles) {
+            for (int y = 0; y < this->height; y++) {
+                convertRow(in + y * w, this->mask != NULL ? this->mask + y * w : NULL, out + y * w);
+            }
+            return;
+        }
+
+        for (int y = 0; y <= this->height; y++) {
+            if (y < this->height) {
+                convertRow(in + y * w, this->mask != NULL ? this->mask + y * w : NULL, ringRow(y));
+            }
+            if (y > 0) {
+                int r = y - 1;
+                fillRow(r > 0 ? ringRow(r - 1) : NULL, ringRow(r), y < this->height ? ringRow(y) : NULL, this->mask != NULL ? this->mask + r * w : NULL, out + r * w);
+            }
+        }
+    }
+
+public:
+
+    DepthPreprocessor(int width, int height) : width(width), height(height), scale(10000.0f), disparityTable(NULL), mask(NULL), fillHoles(false), minNeighbours(5), ring(new uint16_t[4 * (width + 2)]), ones(new uint16_t[width]) {
+        // the fourth row is the all zero row outside the frame
+        std::memset(this->ring, 0, 4 * (width + 2) * sizeof (uint16_t));
+        for (int x = 0; x < width; x++) {
+            this->ones[x] = 1;
+        }
+    }
+
+    ~DepthPreprocessor() {
+        if (this->ring != NULL) {
+            delete[] this->ring;
+        }
+
+        if (this->ones != NULL) {
+            delete[] this->ones;
+        }
+    }
+
+    // depth in [0, 1] (or any float unit) times scale gives mm
+    void process(const float* in, uint16_t* out) {
+        run(in, out);
+    }
+
+    // raw depth in mm, or raw disparity with a disparity table
+    void process(const uint16_t* in, uint16_t* out) {
+        run(in, out);
+    }
+
+    /**
+     * Saturating float to mm conversion of size values without mask or
+     * hole filling.
+     */
+    static void convert(const float* in, uint16_t* out, const int size, const float scale) {
+        for (int i = 0; i < size; i++) {
+            float f = in[i] * scale + 0.5f;
+            f = f > 0.0f ? f : 0.0f; // also catches NaN
+            f = f < 65535.0f ? f : 65535.0f;
+            out[i] = (uint16_t) f;
+        }
+    }
+
+    void setScale(float value) {
+        this->scale = value;
+    }
+
+    float getScale() {
+        return this->scale;
+    }
+
+    /**
+     * 2048 entry table from 11 bit disparity to mm, e.g.
+     * DisparityLUT::getTable(); uint16_t input is then looked up instead of
+     * copied. NULL for input in mm. Not owned.
+     */
+    void setDisparityTable(const uint16_t* value) {
+        this->disparityTable = value;
+    }
+
+    const uint16_t* getDisparityTable() {
+        return this->disparityTable;
+    }
+
+    // width * height values of 0 or 1, NULL for no mask; not owned
+    void setMask(const uint16_t* value) {
+        this->mask = value;
+    }
+
+    const uint16_t* getMask() {
+        return this->mask;
+    }
+
+    void setFillHoles(bool value) {
+        this->fillHoles = value;
+    }
+
+    bool getFillHoles() {
+        return this->fillHoles;
+    }
+
+    // valid neighbours (of 8) a hole needs to be filled
+    void setMinNeighbours(int value) {
+        this->minNeighbours = value;
+    }
+
+    int getMinNeighbours() {
+        return this->minNeighbours;
+    }
+
+    int getWidth() {
+        return this->width;
+    }
+
+    int getHeight() {
+        return this->height;
+    }
+};
+
+#endif /* DEPTHPREPROCESSOR_H */
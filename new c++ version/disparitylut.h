@@ -0,0 +1,69 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DISPARITYLUT_H
+#define DISPARITYLUT_H
+
+#include <stdint.h>
+
+/**
+ * Millimetres for the 11 bit raw disparity of the Kinect v1.
+ *
+ * The 2048 entries are computed once from the usual OpenKinect fit
+ * mm = 1000 / (raw * -0.0030711016 + 3.3309495161). 2047 (no reading) and
+ * everything beyond maxRange, including the raw values near and past the
+ * fit's pole, map to 0, the NO_VALUE of the depth maps. Only the low 11 bits
+ * of a raw value are used.
+ */
+class DisparityLUT {
+public:
+    static const int SIZE = 2048;
+    static const int MAX_RANGE = 10000; // mm, the sensor reads nothing reliable beyond
+
+private:
+    uint16_t table[SIZE];
+
+public:
+
+    // maxRange in mm, below 65535
+    DisparityLUT(int maxRange = MAX_RANGE) {
+        for (int raw = 0; raw < SIZE; raw++) {
+            double denominator = raw * -0.0030711016 + 3.3309495161;
+            double mm = denominator > 0 ? 1000.0 / denominator : 0;
+            this->table[raw] = raw == SIZE - 1 || mm > maxRange ? 0 : (uint16_t) (mm + 0.5);
+        }
+    }
+
+    uint16_t toMillimetres(const uint16_t& raw) const {
+        return this->table[raw & (SIZE - 1)];
+    }
+
+    void apply(const uint16_t* raw, uint16_t* mm, const int size) const {
+        for (int i = 0; i < size; i++) {
+            mm[i] = this->table[raw[i] & (SIZE - 1)];
+        }
+    }
+
+    const uint16_t* getTable() const {
+        return this->table;
+    }
+};
+
+#endif /* DISPARITYLUT_H */
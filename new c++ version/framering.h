@@ -0,0 +1,319 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+/**
+ * Preallocated ring of depth frames between one producer (the capture
+ * callback) and one consumer (the tracking thread).
+ *
+ * The producer asks for a slot with acquireWrite(), lets the driver write
+ * the frame into it and publishes it with commitWrite(). The consumer takes
+ * a frame with acquireRead() and hands the slot back with releaseRead().
+ *
+ * Every slot has one atomic word holding its state (free, writing, ready,
+ * reading) in the low two bits and the sequence number of its frame above
+ * them, so a state change is a single compare-and-swap that also checks it
+ * is still the same frame. Slots are only contended when the producer
+ * evicts a ready frame the consumer is about to take; the CAS decides.
+ *
+ * When no slot is free the policy decides:
+ *   DROP_OLDEST  the oldest ready frame is overwritten, frames are read in
+ *                order
+ *   KEEP_LATEST  like DROP_OLDEST, and the consumer always takes the newest
+ *                ready frame and drops the older ones, so it is never more
+ *                than one frame behind
+ *   BLOCK        the producer waits for the consumer, nothing is dropped
+ * With the first two the producer never waits for the consumer. A mutex is
+ * only taken to wake up a side that sleeps because there is nothing to do.
+ */
+class FrameRing {
+public:
+
+    enum Policy {
+        DROP_OLDEST, KEEP_LATEST, BLOCK
+    };
+
+private:
+
+    enum State {
+        FREE = 0, WRITING = 1, READY = 2, READING = 3
+    };
+
+    int width;
+    int height;
+    int numSlots;
+    Policy policy;
+    uint16_t* frames;
+    uint64_t* timestamps;
+    std::atomic<uint64_t>* slots;
+    int writing; // slot of the producer, -1 if none
+    int reading; // slot of the consumer, -1 if none
+    uint64_t sequence; // of the next frame, producer only
+
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> dropped;
+    std::atomic<bool> closed;
+    std::atomic<bool> consumerWaiting;
+    std::atomic<bool> producerWaiting;
+    std::mutex mutex;
+    std::condition_variable readable;
+    std::condition_variable writable;
+
+    static uint64_t pack(const uint64_t& sequence, const int& state) {
+        return (sequence << 2) | state;
+    }
+
+    static int stateOf(const uint64_t& word) {
+        return (int) (word & 3);
+    }
+
+    static uint64_t sequenceOf(const uint64_t& word) {
+        return word >> 2;
+    }
+
+    // slot of the oldest (or newest) ready frame, -1 if there is none
+    int findReady(bool newest, uint64_t* word) const {
+        int found = -1;
+        for (int i = 0; i < this->numSlots; i++) {
+            uint64_t w = this->slots[i].load(std::memory_order_acquire);
+            if (stateOf(w) == READY && (found == -1 || (newest ? sequenceOf(w) > sequenceOf(*word) : sequenceOf(w) < sequenceOf(*word)))) {
+                found = i;
+                *word = w;
+            }
+        }
+        return found;
+    }
+
+    bool claim(const int& slot, uint64_t word, const int& state) {
+        return this->slots[slot].compare_exchange_strong(word, pack(sequenceOf(word), state), std::memory_order_acq_rel);
+    }
+
+    /**
+     * The fence pairs with the one after the other side sets waiting: either
+     * that side sees the slot just stored, or this one sees it waiting.
+     */
+    void wake(std::atomic<bool>& waiting, std::condition_variable& condition) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            condition.notify_one();
+        }
+    }
+
+    int frameSize() const {
+        return this->width * this->height;
+    }
+
+public:
+
+    // one slot for the producer, one for the consumer, the rest queue; at least 2
+    FrameRing(int width, int height, int numSlots = 3, Policy policy = KEEP_LATEST) : width(width), height(height), numSlots(numSlots < 2 ? 2 : numSlots), policy(policy), frames(new uint16_t[this->numSlots * width * height]), timestamps(new uint64_t[this->numSlots]), slots(new std::atomic<uint64_t>[this->numSlots]), writing(-1), reading(-1), sequence(0), written(0), dropped(0), closed(false), consumerWaiting(false), producerWaiting(false) {
+        for (int i = 0; i < this->numSlots; i++) {
+            this->slots[i].store(pack(0, FREE));
+            this->timestamps[i] = 0;
+        }
+    }
+
+    ~FrameRing() {
+        if (this->frames != NULL) {
+            delete[] this->frames;
+        }
+
+        if (this->timestamps != NULL) {
+            delete[] this->timestamps;
+        }
+
+        if (this->slots != NULL) {
+            delete[] this->slots;
+        }
+    }
+
+    /**
+     * Slot for the next frame, width * height values. Returns NULL only if
+     * the ring has been closed (or, with BLOCK, while the consumer holds all
+     * slots and the ring gets closed).
+     */
+    uint16_t* acquireWrite() {
+        while (!this->closed.load()) {
+            for (int i = 0; i < this->numSlots; i++) {
+                uint64_t w = this->slots[i].load(std::memory_order_acquire);
+                if (stateOf(w) == FREE && claim(i, w, WRITING)) {
+                    this->writing = i;
+                    return this->frames + i * frameSize();
+                }
+            }
+
+            if (this->policy != BLOCK) {
+                uint64_t w = 0;
+                int i = findReady(false, &w);
+                if (i != -1 && claim(i, w, WRITING)) {
+                    this->dropped++;
+                    this->writing = i;
+                    return this->frames + i * frameSize();
+                }
+                // the consumer took it in between, look again
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->producerWaiting.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool free = false;
+            for (int i = 0; i < this->numSlots && !free; i++) {
+                free = stateOf(this->slots[i].load()) == FREE;
+            }
+            if (!free && !this->closed.load()) {
+                this->writable.wait_for(lock, std::chrono::milliseconds(10));
+            }
+            this->producerWaiting.store(false);
+        }
+        return NULL;
+    }
+
+    // publishes the frame written into the slot of acquireWrite()
+    void commitWrite(uint64_t timestamp = 0) {
+        if (this->writing == -1) {
+            return;
+        }
+        this->timestamps[this->writing] = timestamp;
+        this->slots[this->writing].store(pack(this->sequence++, READY), std::memory_order_release);
+        this->writing = -1;
+        this->written++;
+        wake(this->consumerWaiting, this->readable);
+    }
+
+    // gives the slot of acquireWrite() back without publishing it
+    void cancelWrite() {
+        if (this->writing == -1) {
+            return;
+        }
+        this->slots[this->writing].store(pack(this->sequence, FREE), std::memory_order_release);
+        this->writing = -1;
+    }
+
+    /**
+     * Next frame for the consumer, NULL if none arrived within timeoutMs or
+     * the ring is closed. sequence and timestamp may be NULL.
+     */
+    const uint16_t* acquireRead(int timeoutMs, uint64_t* sequence = NULL, uint64_t* timestamp = NULL) {
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        const bool newest = this->policy == KEEP_LATEST;
+
+        for (;;) {
+            uint64_t w = 0;
+            int i = findReady(newest, &w);
+            if (i != -1) {
+                if (!claim(i, w, READING)) {
+                    continue;
+                }
+                if (newest) {
+                    for (int j = 0; j < this->numSlots; j++) {
+                        uint64_t older = this->slots[j].load(std::memory_order_acquire);
+                        if (stateOf(older) == READY && sequenceOf(older) < sequenceOf(w) && claim(j, older, FREE)) {
+                            this->dropped++;
+                        }
+                    }
+                }
+                this->reading = i;
+                if (sequence != NULL) {
+                    *sequence = sequenceOf(w);
+                }
+                if (timestamp != NULL) {
+                    *timestamp = this->timestamps[i];
+                }
+                return this->frames + i * frameSize();
+            }
+
+            if (this->closed.load() || std::chrono::steady_clock::now() >= deadline) {
+                return NULL;
+            }
+
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->consumerWaiting.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (findReady(false, &w) == -1 && !this->closed.load()) {
+                this->readable.wait_until(lock, deadline);
+            }
+            this->consumerWaiting.store(false);
+        }
+    }
+
+    // hands the slot of acquireRead() back to the producer
+    void releaseRead() {
+        if (this->reading == -1) {
+            return;
+        }
+        uint64_t w = this->slots[this->reading].load(std::memory_order_acquire);
+        this->slots[this->reading].store(pack(sequenceOf(w), FREE), std::memory_order_release);
+        this->reading = -1;
+        wake(this->producerWaiting, this->writable);
+    }
+
+    /**
+     * Wakes up both sides. acquireWrite() returns NULL from then on,
+     * acquireRead() as soon as no ready frame is left.
+     */
+    void close() {
+        this->closed.store(true);
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->readable.notify_all();
+        this->writable.notify_all();
+    }
+
+    bool isClosed() {
+        return this->closed.load();
+    }
+
+    // frames published by the producer
+    uint64_t getWritten() {
+        return this->written.load();
+    }
+
+    // frames overwritten or skipped before the consumer got them
+    uint64_t getDropped() {
+        return this->dropped.load();
+    }
+
+    Policy getPolicy() {
+        return this->policy;
+    }
+
+    int getNumberOfSlots() {
+        return this->numSlots;
+    }
+
+    int getWidth() {
+        return this->width;
+    }
+
+    int getHeight() {
+        return this->height;
+    }
+};
+
+#endif /* FRAMERING_H */
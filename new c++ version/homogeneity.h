@@ -37,6 +37,7 @@
 #define HOMOGENEITY_H
 
 #include <backgroundmodel.h>
+#include <backgroundscheduler.h>
 #include <iostream>
 #include <stdlib.h>
 #include <complex>
@@ -47,6 +48,7 @@ using namespace std;
 template <typename BACKGROUNDMODEL> class Homogeneity {
 private:
     BACKGROUNDMODEL* bgmodel;
+    BackgroundScheduler* scheduler;
 
     uint16_t* current;
     int width;
@@ -57,7 +59,7 @@ private:
 
 public:
 
-    Homogeneity(uint16_t* depthMap, int width, int height) : bgmodel(new BACKGROUNDMODEL(depthMap, width, height)), current(depthMap), width(width), height(height), maxDistance(2100), minDistance(800), thresholdOffset(15) {
+    Homogeneity(uint16_t* depthMap, int width, int height) : bgmodel(new BACKGROUNDMODEL(depthMap, width, height)), scheduler(NULL), current(depthMap), width(width), height(height), maxDistance(2100), minDistance(800), thresholdOffset(15) {
     }
 
     virtual ~Homogeneity() {
@@ -77,8 +79,33 @@ public:
     }
 
     virtual void update(int* occu) {
-        getBackgroundModel()->update(this->current);
-        getBackgroundModel()->update(occu);
+        updateBackground(this->current, occu);
+    }
+
+    /**
+     * Background update with an explicit frame, so that it can run for one
+     * frame while the criterion is evaluated on the next.
+     */
+    virtual void updateBackground(uint16_t* depthMap, int* occu) {
+        getBackgroundModel()->update(depthMap);
+        if (this->scheduler != NULL) {
+            this->scheduler->update(getBackgroundModel(), occu);
+        } else {
+            getBackgroundModel()->update(occu);
+            getBackgroundModel()->markUpdated(0, 0, this->width, this->height);
+        }
+    }
+
+    /**
+     * With a scheduler the background model is updated a few tiles per
+     * frame instead of all at once. The scheduler is not owned.
+     */
+    void setBackgroundScheduler(BackgroundScheduler* value) {
+        this->scheduler = value;
+    }
+
+    BackgroundScheduler* getBackgroundScheduler() {
+        return this->scheduler;
     }
 
     inline uint16_t getValue(const uint16_t* map, int wrap, int x, int y, int w, int h) {
@@ -0,0 +1,125 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ
+ * email: christ_o@gmx.de
+ *
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEDIANCENTROID_H
+#define MEDIANCENTROID_H
+
+#include <tracker.h>
+#include <cstring>
+
+/**
+ * Median center of contour lines by counting sort.
+ *
+ * Contour coordinates are bounded by the frame (0..width, 0..height), so the
+ * median of a line is found with one histogram per axis instead of copying the
+ * points and running nth_element. The histograms are allocated once and only
+ * the touched range is cleared after each query, so a query costs
+ * O(points + extent of the line) and never allocates.
+ */
+class MedianCentroid {
+private:
+    int width;
+    int height;
+    int* xHistogram;
+    int* yHistogram;
+
+    static int select(int* histogram, const int& minValue, const int& maxValue, const int& rank) {
+        int result = maxValue;
+        int count = 0;
+        for (int v = minValue; v <= maxValue; v++) {
+            count += histogram[v];
+            if (count > rank) {
+                result = v;
+                break;
+            }
+        }
+        std::memset(histogram + minValue, 0, (maxValue - minValue + 1) * sizeof (int));
+        return result;
+    }
+
+public:
+
+    // contour points lie on the (width + 1) x (height + 1) grid of pixel corners
+    MedianCentroid(int width, int height) : width(width), height(height), xHistogram(new int[width + 1]), yHistogram(new int[height + 1]) {
+        std::memset(this->xHistogram, 0, (width + 1) * sizeof (int));
+        std::memset(this->yHistogram, 0, (height + 1) * sizeof (int));
+    }
+
+    ~MedianCentroid() {
+        if (this->xHistogram != NULL) {
+            delete[] this->xHistogram;
+        }
+
+        if (this->yHistogram != NULL) {
+            delete[] this->yHistogram;
+        }
+    }
+
+    /**
+     * Median of the points [start, end) of a contour. Returns the same element
+     * as nth_element at (end - start) / 2.
+     */
+    void getMedian(const Contour& contour, const int& start, const int& end, int* x, int* y) {
+        if (end <= start) {
+            *x = 0;
+            *y = 0;
+            return;
+        }
+
+        int xmin = this->width;
+        int xmax = 0;
+        int ymin = this->height;
+        int ymax = 0;
+
+        for (int i = start; i < end; i++) {
+            const int& px = contour.getX(i);
+            const int& py = contour.getY(i);
+            this->xHistogram[px]++;
+            this->yHistogram[py]++;
+            xmin = px < xmin ? px : xmin;
+            xmax = px > xmax ? px : xmax;
+            ymin = py < ymin ? py : ymin;
+            ymax = py > ymax ? py : ymax;
+        }
+
+        int rank = (end - start) / 2;
+        *x = select(this->xHistogram, xmin, xmax, rank);
+        *y = select(this->yHistogram, ymin, ymax, rank);
+    }
+
+    /**
+     * Medians of all lines of a contour. x and y must hold
+     * contour.getNumberOfLines() entries.
+     */
+    void getMedians(const Contour& contour, int* x, int* y) {
+        for (int i = 0; i < contour.getNumberOfLines(); i++) {
+            getMedian(contour, contour.lineStart(i), contour.lineEnd(i), &x[i], &y[i]);
+        }
+    }
+
+    int getWidth() {
+        return this->width;
+    }
+
+    int getHeight() {
+        return this->height;
+    }
+};
+
+#endif /* MEDIANCENTROID_H */
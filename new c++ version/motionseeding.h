@@ -0,0 +1,90 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MOTIONSEEDING_H
+#define MOTIONSEEDING_H
+
+#include <trackassociator.h>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+/**
+ * Seeds the next frame densely where the tracked regions are expected.
+ *
+ * Every track's bounding box is moved along its velocity (for tracks that
+ * were missed, once per missed frame) and widened by margin plus the
+ * distance moved, and handed to the tracker as a seed window. The spacing
+ * within a window is a quarter of the smaller box side, between minSpacing
+ * and maxSpacing, so small regions are sampled as reliably as large ones.
+ * Regions that moved further than their drops reach are found again in the
+ * frame they arrive; the full seed grid then only has to find new regions
+ * and can be scanned a few rows per frame, see Tracker::setSeedingPeriod().
+ */
+class MotionSeeding {
+private:
+    int margin;
+    int minSpacing;
+    int maxSpacing;
+
+public:
+
+    MotionSeeding(int margin = 8, int minSpacing = 2, int maxSpacing = 8) : margin(margin), minSpacing(minSpacing), maxSpacing(maxSpacing) {
+    }
+
+    template <typename TRACKER> void apply(TRACKER& tracker, const std::vector<Track>& tracks) {
+        for (size_t i = 0; i < tracks.size(); i++) {
+            const Track& track = tracks[i];
+            const int steps = track.missed + 1;
+            const int dx = (int) std::floor(track.vx * steps + 0.5f);
+            const int dy = (int) std::floor(track.vy * steps + 0.5f);
+            const int ex = this->margin + std::abs(dx);
+            const int ey = this->margin + std::abs(dy);
+
+            int spacing = std::min(track.x1 - track.x0, track.y1 - track.y0) / 4;
+            spacing = spacing < this->minSpacing ? this->minSpacing : (spacing > this->maxSpacing ? this->maxSpacing : spacing);
+            tracker.addSeedWindow(track.x0 + dx - ex, track.y0 + dy - ey, track.x1 + dx + ex, track.y1 + dy + ey, spacing);
+        }
+    }
+
+    // pixels added around the predicted box
+    void setMargin(int value) {
+        this->margin = value;
+    }
+
+    int getMargin() {
+        return this->margin;
+    }
+
+    void setSpacing(int minSpacing, int maxSpacing) {
+        this->minSpacing = minSpacing;
+        this->maxSpacing = maxSpacing;
+    }
+
+    int getMinSpacing() {
+        return this->minSpacing;
+    }
+
+    int getMaxSpacing() {
+        return this->maxSpacing;
+    }
+};
+
+#endif /* MOTIONSEEDING_H */
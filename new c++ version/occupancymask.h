@@ -0,0 +1,135 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ
+ * email: christ_o@gmx.de
+ *
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OCCUPANCYMASK_H
+#define OCCUPANCYMASK_H
+
+#include <stdint.h>
+#include <cstring>
+
+/**
+ * Occupancy map dilated by a square window.
+ *
+ * getMask()[i] is non zero if any pixel within radius (Chebyshev distance) of
+ * pixel i is occupied, so the background models can ask "is this pixel and
+ * its neighbourhood free" with one byte read. The dilation is separable: a
+ * row pass ORs 2 * radius + 1 neighbours along x into a byte buffer, a column
+ * pass ORs 2 * radius + 1 of those rows. Both passes stream through memory
+ * and are written so that the compiler vectorizes them. Pixels outside the
+ * frame count as free.
+ */
+class OccupancyMask {
+private:
+    int width;
+    int height;
+    int radius;
+    uint8_t* line;
+    uint8_t* rows;
+    uint8_t* mask;
+
+public:
+
+    OccupancyMask(int width, int height, int radius = 2) : width(width), height(height), radius(radius), line(new uint8_t[width + 2 * radius]), rows(new uint8_t[width * height]), mask(new uint8_t[width * height]) {
+        std::memset(this->line, 0, (width + 2 * radius) * sizeof (uint8_t));
+        std::memset(this->rows, 0, width * height * sizeof (uint8_t));
+        std::memset(this->mask, 0, width * height * sizeof (uint8_t));
+    }
+
+    ~OccupancyMask() {
+        if (this->line != NULL) {
+            delete[] this->line;
+        }
+
+        if (this->rows != NULL) {
+            delete[] this->rows;
+        }
+
+        if (this->mask != NULL) {
+            delete[] this->mask;
+        }
+    }
+
+    /**
+     * Dilates the rectangle [x0, x1) x [y0, y1) of the occupancy map. The row
+     * pass also covers radius rows above and below, which the column pass
+     * reads; the mask outside the rectangle is left as it was.
+     */
+    void update(const int* occu, const int& x0, const int& y0, const int& x1, const int& y1) {
+        const int w = this->width;
+        const int r = this->radius;
+        const int n = x1 - x0;
+        int ry0 = y0 - r > 0 ? y0 - r : 0;
+        int ry1 = y1 + r < this->height ? y1 + r : this->height;
+        int rx0 = x0 - r > 0 ? x0 - r : 0;
+        int rx1 = x1 + r < w ? x1 + r : w;
+
+        // line holds the row from x0 - r to x1 + r, zero outside the frame
+        uint8_t* padded = this->line + r;
+        std::memset(this->line, 0, (n + 2 * r) * sizeof (uint8_t));
+        for (int y = ry0; y < ry1; y++) {
+            const int* in = occu + y * w;
+            uint8_t* out = this->rows + y * w + x0;
+            for (int x = rx0; x < rx1; x++) {
+                padded[x - x0] = in[x] != 0;
+            }
+            std::memcpy(out, padded - r, n * sizeof (uint8_t));
+            for (int k = -r + 1; k <= r; k++) {
+                const uint8_t* shifted = padded + k;
+                for (int x = 0; x < n; x++) {
+                    out[x] |= shifted[x];
+                }
+            }
+        }
+
+        for (int y = y0; y < y1; y++) {
+            int top = y - r > 0 ? y - r : 0;
+            int bottom = y + r < this->height - 1 ? y + r : this->height - 1;
+            uint8_t* out = this->mask + y * w + x0;
+            std::memcpy(out, this->rows + top * w + x0, n * sizeof (uint8_t));
+            for (int yy = top + 1; yy <= bottom; yy++) {
+                const uint8_t* in = this->rows + yy * w + x0;
+                for (int x = 0; x < n; x++) {
+                    out[x] |= in[x];
+                }
+            }
+        }
+    }
+
+    void update(const int* occu) {
+        update(occu, 0, 0, this->width, this->height);
+    }
+
+    const uint8_t* getMask() const {
+        return this->mask;
+    }
+
+    int getRadius() {
+        return this->radius;
+    }
+
+    int getWidth() {
+        return this->width;
+    }
+
+    int getHeight() {
+        return this->height;
+    }
+};
+
+#endif /* OCCUPANCYMASK_H */
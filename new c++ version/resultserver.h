@@ -0,0 +1,534 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef RESULTSERVER_H
+#define RESULTSERVER_H
+
+#include <tracker.h>
+#include <contourmoments.h>
+#include <rotatingcaliper.h>
+#include <GrahamScanConvexHull.h>
+#include <stdint.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+/**
+ * Wire format of ResultServer. Every frame is one message, a
+ * ResultMessageHeader followed by numRegions records. A record is a
+ * ResultRegion, followed, if the header has RESULT_CHAIN_CODES set, by the
+ * chain code of the region's contour line: the first point as two int16_t,
+ * then chainLength steps of 2 bits, four per byte starting at the low bits
+ * (0 = +x, 1 = +y, 2 = -x, 3 = -y), padded to a multiple of 4 bytes. All
+ * values are in host byte order, the stream never leaves the host.
+ */
+static const uint32_t RESULT_MAGIC = 0x52474254; // "TBGR"
+static const uint32_t RESULT_CHAIN_CODES = 1;
+
+class ResultMessageHeader {
+public:
+    uint32_t magic;
+    uint32_t size; // of the whole message in bytes
+    uint64_t sequence;
+    uint64_t timestamp;
+    uint32_t numRegions;
+    uint32_t flags;
+};
+
+class ResultRegion {
+public:
+    int32_t id;
+    int32_t signedArea; // > 0 for outer boundaries, < 0 for holes
+    float cx;
+    float cy;
+    int16_t x0, y0, x1, y1; // axis aligned bounding box
+    int16_t obb[8]; // corners of the oriented bounding box, x, y
+    uint32_t chainLength; // steps in the chain code, 0 without
+};
+
+/**
+ * Streams the results of every frame to any number of local clients over a
+ * Unix domain socket.
+ *
+ * publish() only copies the contour into a spare buffer and swaps it in
+ * under a lock that is held for a pointer swap, so it never waits for the
+ * network. The server thread runs an epoll loop over nonblocking sockets; it
+ * encodes each frame once (centroids, bounding boxes and optionally chain
+ * codes, see ResultRegion) and queues the same buffer for every client. A
+ * client whose queue already holds maxQueuedFrames frames loses its oldest
+ * frame that is not being sent, so slow clients see fewer frames instead of
+ * stalling the others. If the server thread itself falls behind, publish()
+ * replaces the frame that was not picked up yet.
+ *
+ * Clients connect to the socket and read; whatever they send is ignored.
+ */
+class ResultServer {
+private:
+    typedef std::shared_ptr<const std::vector<uint8_t> > Message;
+
+    class Frame {
+    public:
+        Contour contour;
+        std::vector<int32_t> ids;
+        uint64_t sequence;
+        uint64_t timestamp;
+
+        Frame(int size) : contour(size), sequence(0), timestamp(0) {
+        }
+    };
+
+    class Client {
+    public:
+        int fd;
+        uint64_t id; // epoll data; unlike fd and address never reused
+        std::deque<Message> queue;
+        size_t sent; // bytes of queue.front() already written
+        bool writable;
+
+        Client(int fd, uint64_t id) : fd(fd), id(id), sent(0), writable(true) {
+        }
+    };
+
+    // epoll data of the two descriptors that are not clients
+    static const uint64_t LISTEN_ID = 0;
+    static const uint64_t EVENT_ID = 1;
+
+    std::string path;
+    int listenFd;
+    int epollFd;
+    int eventFd;
+    std::atomic<int> maxQueuedFrames;
+    int minContourLength;
+    bool chainCodes;
+    Frame* incoming; // owned by publish()
+    Frame* pending; // handed over, guarded by mutex
+    Frame* working; // owned by the server thread
+    bool hasPending;
+    std::mutex mutex;
+    std::vector<Client*> clients;
+    uint64_t nextId;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> published;
+    std::atomic<uint64_t> skipped;
+    std::atomic<uint64_t> dropped;
+    ContourMoments moments;
+    RegionMoments region;
+    std::vector<uint8_t> scratch;
+
+    static void put(std::vector<uint8_t>& out, const void* data, const size_t& size) {
+        const uint8_t* bytes = (const uint8_t*) data;
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    static int16_t clamp16(const int& value) {
+        return (int16_t) (value < -32768 ? -32768 : (value > 32767 ? 32767 : value));
+    }
+
+    void getOBB(const Contour& contour, const int& start, const int& end, int16_t* obb) {
+        std::vector<point2d> point;
+        for (int i = start; i < end; i++) {
+            point2d p2d;
+            p2d.x = contour.getX(i);
+            p2d.y = contour.getY(i);
+            point.push_back(p2d);
+        }
+
+        std::vector<point2d> convex_hull;
+        GrahamScanConvexHull()(point, convex_hull);
+
+        std::vector<std::pair<int, int> > convexhull;
+        for (int i = convex_hull.size() - 1; i >= 0; i--) {
+            convexhull.push_back(std::make_pair((int) convex_hull.at(i).x, (int) convex_hull.at(i).y));
+        }
+
+        RotatingCaliper rcal;
+        BoundingBox bbox = rcal.getMinimumBoundingBox(convexhull);
+        obb[0] = clamp16(bbox.a.first);
+        obb[1] = clamp16(bbox.a.second);
+        obb[2] = clamp16(bbox.b.first);
+        obb[3] = clamp16(bbox.b.second);
+        obb[4] = clamp16(bbox.c.first);
+        obb[5] = clamp16(bbox.c.second);
+        obb[6] = clamp16(bbox.d.first);
+        obb[7] = clamp16(bbox.d.second);
+    }
+
+    // steps of the contour are unit steps between pixel corners
+    void encodeChain(std::vector<uint8_t>& out, const Contour& contour, const int& start, const int& end) {
+        int16_t first[2] = {clamp16(contour.getX(start)), clamp16(contour.getY(start))};
+        put(out, first, sizeof (first));
+        size_t base = out.size();
+        int steps = end - start - 1;
+        out.resize(base + ((steps + 15) / 16) * 4, 0);
+        for (int i = 0; i < steps; i++) {
+            int dx = contour.getX(start + i + 1) - contour.getX(start + i);
+            int dy = contour.getY(start + i + 1) - contour.getY(start + i);
+            int code = dx > 0 ? 0 : (dy > 0 ? 1 : (dx < 0 ? 2 : 3));
+            out[base + i / 4] |= code << (2 * (i % 4));
+        }
+    }
+
+    Message encode(const Frame& frame) {
+        std::vector<uint8_t>& out = this->scratch;
+        out.clear();
+        ResultMessageHeader header;
+        std::memset(&header, 0, sizeof (header));
+        header.magic = RESULT_MAGIC;
+        header.sequence = frame.sequence;
+        header.timestamp = frame.timestamp;
+        header.flags = this->chainCodes ? RESULT_CHAIN_CODES : 0;
+        put(out, &header, sizeof (header));
+
+        const Contour& contour = frame.contour;
+        for (int l = 0; l < contour.getNumberOfLines(); l++) {
+            const int start = contour.lineStart(l);
+            const int end = contour.lineEnd(l);
+            if (end - start < this->minContourLength || end - start < 3) {
+                continue;
+            }
+
+            ResultRegion r;
+            std::memset(&r, 0, sizeof (r));
+            r.id = l < (int) frame.ids.size() ? frame.ids[l] : l;
+            this->moments.compute(contour, start, end, this->region);
+            r.signedArea = (int32_t) this->region.signedArea;
+            r.cx = (float) this->region.cx;
+            r.cy = (float) this->region.cy;
+            int x0 = contour.getX(start), y0 = contour.getY(start), x1 = x0, y1 = y0;
+            for (int i = start + 1; i < end; i++) {
+                x0 = contour.getX(i) < x0 ? contour.getX(i) : x0;
+                y0 = contour.getY(i) < y0 ? contour.getY(i) : y0;
+                x1 = contour.getX(i) > x1 ? contour.getX(i) : x1;
+                y1 = contour.getY(i) > y1 ? contour.getY(i) : y1;
+            }
+            r.x0 = clamp16(x0);
+            r.y0 = clamp16(y0);
+            r.x1 = clamp16(x1);
+            r.y1 = clamp16(y1);
+            getOBB(contour, start, end, r.obb);
+            r.chainLength = this->chainCodes ? end - start - 1 : 0;
+            put(out, &r, sizeof (r));
+            if (this->chainCodes) {
+                encodeChain(out, contour, start, end);
+            }
+            header.numRegions++;
+        }
+
+        header.size = (uint32_t) out.size();
+        std::memcpy(&out[0], &header, sizeof (header));
+        return Message(new std::vector<uint8_t>(out));
+    }
+
+    void closeClient(const size_t& index) {
+        Client* client = this->clients[index];
+        epoll_ctl(this->epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+        ::close(client->fd);
+        delete client;
+        this->clients[index] = this->clients.back();
+        this->clients.pop_back();
+    }
+
+    // writes as much of the queue as the socket takes; false if the client is gone
+    bool flush(Client* client) {
+        while (!client->queue.empty()) {
+            const std::vector<uint8_t>& message = *client->queue.front();
+            ssize_t n = send(client->fd, &message[client->sent], message.size() - client->sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            client->sent += n;
+            if (client->sent == message.size()) {
+                client->queue.pop_front();
+                client->sent = 0;
+            }
+        }
+
+        // only ask for EPOLLOUT while there is something left to send
+        bool writable = client->queue.empty();
+        if (writable != client->writable) {
+            epoll_event event;
+            event.events = EPOLLIN | (writable ? 0 : EPOLLOUT);
+            event.data.u64 = client->id;
+            epoll_ctl(this->epollFd, EPOLL_CTL_MOD, client->fd, &event);
+            client->writable = writable;
+        }
+        return true;
+    }
+
+    void enqueue(const Message& message) {
+        for (size_t i = 0; i < this->clients.size();) {
+            Client* client = this->clients[i];
+            if ((int) client->queue.size() >= this->maxQueuedFrames.load(std::memory_order_relaxed)) {
+                // keep the frame that is partially written
+                size_t victim = client->sent > 0 ? 1 : 0;
+                if (victim < client->queue.size()) {
+                    client->queue.erase(client->queue.begin() + victim);
+                    this->dropped++;
+                }
+            }
+            client->queue.push_back(message);
+            if (client->writable && !flush(client)) {
+                closeClient(i);
+                continue;
+            }
+            i++;
+        }
+    }
+
+    void accept() {
+        for (;;) {
+            int fd = ::accept4(this->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            Client* client = new Client(fd, this->nextId++);
+            epoll_event event;
+            event.events = EPOLLIN;
+            event.data.u64 = client->id;
+            epoll_ctl(this->epollFd, EPOLL_CTL_ADD, fd, &event);
+            this->clients.push_back(client);
+        }
+    }
+
+    size_t find(const uint64_t& id) const {
+        for (size_t i = 0; i < this->clients.size(); i++) {
+            if (this->clients[i]->id == id) {
+                return i;
+            }
+        }
+        return this->clients.size();
+    }
+
+    void run() {
+        epoll_event events[64];
+        while (this->running.load()) {
+            int n = epoll_wait(this->epollFd, events, 64, 100);
+            for (int e = 0; e < n; e++) {
+                uint64_t id = events[e].data.u64;
+                if (id == LISTEN_ID) {
+                    accept();
+                } else if (id == EVENT_ID) {
+                    uint64_t count;
+                    ssize_t ignored = read(this->eventFd, &count, sizeof (count));
+                    (void) ignored;
+                    bool fresh;
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        fresh = this->hasPending;
+                        if (fresh) {
+                            std::swap(this->pending, this->working);
+                            this->hasPending = false;
+                        }
+                    }
+                    if (fresh) {
+                        enqueue(encode(*this->working));
+                    }
+                } else {
+                    // the client may have been closed by enqueue() above
+                    size_t index = find(id);
+                    if (index == this->clients.size()) {
+                        continue;
+                    }
+                    Client* client = this->clients[index];
+                    bool alive = (events[e].events & (EPOLLHUP | EPOLLERR)) == 0;
+                    if (alive && (events[e].events & EPOLLIN) != 0) {
+                        char buffer[256];
+                        ssize_t r = recv(client->fd, buffer, sizeof (buffer), 0);
+                        alive = r > 0 || (r < 0 && (errno == EAGAIN || errno == EINTR));
+                    }
+                    if (alive && (events[e].events & EPOLLOUT) != 0) {
+                        alive = flush(client);
+                    }
+                    if (!alive) {
+                        closeClient(index);
+                    }
+                }
+            }
+        }
+    }
+
+    void closeAll() {
+        while (!this->clients.empty()) {
+            closeClient(this->clients.size() - 1);
+        }
+        if (this->listenFd >= 0) {
+            ::close(this->listenFd);
+            unlink(this->path.c_str());
+            this->listenFd = -1;
+        }
+        if (this->epollFd >= 0) {
+            ::close(this->epollFd);
+            this->epollFd = -1;
+        }
+        if (this->eventFd >= 0) {
+            ::close(this->eventFd);
+            this->eventFd = -1;
+        }
+    }
+
+public:
+
+    ResultServer(int width, int height) : listenFd(-1), epollFd(-1), eventFd(-1), maxQueuedFrames(4), minContourLength(3), chainCodes(false), incoming(new Frame((width + 1) * (height + 1))), pending(new Frame((width + 1) * (height + 1))), working(new Frame((width + 1) * (height + 1))), hasPending(false), nextId(EVENT_ID + 1), running(false), published(0), skipped(0), dropped(0) {
+    }
+
+    ~ResultServer() {
+        stop();
+        delete this->incoming;
+        delete this->pending;
+        delete this->working;
+    }
+
+    /**
+     * Listens on the Unix domain socket path and starts the server thread.
+     * An existing socket file at path is replaced.
+     */
+    bool start(const char* path) {
+        if (this->running.load()) {
+            return false;
+        }
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof (address));
+        address.sun_family = AF_UNIX;
+        if (std::strlen(path) >= sizeof (address.sun_path)) {
+            return false;
+        }
+        std::strcpy(address.sun_path, path);
+        this->path = path;
+
+        unlink(path);
+        this->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        this->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (this->listenFd < 0 || this->epollFd < 0 || this->eventFd < 0 || bind(this->listenFd, (sockaddr*) &address, sizeof (address)) != 0 || listen(this->listenFd, 64) != 0) {
+            closeAll();
+            return false;
+        }
+
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = LISTEN_ID;
+        epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->listenFd, &event);
+        event.data.u64 = EVENT_ID;
+        epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->eventFd, &event);
+
+        this->running.store(true);
+        this->thread = std::thread(&ResultServer::run, this);
+        return true;
+    }
+
+    // disconnects all clients and removes the socket file
+    void stop() {
+        this->running.store(false);
+        if (this->thread.joinable()) {
+            this->thread.join();
+        }
+        closeAll();
+    }
+
+    /**
+     * Hands a frame to the server thread. ids (one per contour line, may be
+     * NULL) become the region ids, otherwise the line index is used. Call from
+     * one thread only, e.g. right after TrackingHelper::process().
+     */
+    void publish(const Contour& contour, uint64_t sequence, uint64_t timestamp = 0, const int* ids = NULL) {
+        if (!this->running.load()) {
+            return;
+        }
+        Frame* frame = this->incoming;
+        frame->contour.copyFrom(contour);
+        frame->ids.assign(ids, ids == NULL ? ids : ids + contour.getNumberOfLines());
+        frame->sequence = sequence;
+        frame->timestamp = timestamp;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->hasPending) {
+                this->skipped++;
+            }
+            std::swap(this->incoming, this->pending);
+            this->hasPending = true;
+        }
+        uint64_t one = 1;
+        ssize_t ignored = write(this->eventFd, &one, sizeof (one));
+        (void) ignored;
+        this->published++;
+    }
+
+    // frames queued per client before its oldest ones are dropped; may be changed while running
+    void setMaxQueuedFrames(int value) {
+        this->maxQueuedFrames = value < 1 ? 1 : value;
+    }
+
+    int getMaxQueuedFrames() {
+        return this->maxQueuedFrames;
+    }
+
+    // set before start()
+    void setChainCodes(bool value) {
+        this->chainCodes = value;
+    }
+
+    bool getChainCodes() {
+        return this->chainCodes;
+    }
+
+    // shorter contour lines are not sent, e.g. tracker_min_contour_length; set before start()
+    void setMinContourLength(int value) {
+        this->minContourLength = value;
+    }
+
+    int getMinContourLength() {
+        return this->minContourLength;
+    }
+
+    uint64_t getPublished() {
+        return this->published.load();
+    }
+
+    // frames replaced before the server thread picked them up
+    uint64_t getSkipped() {
+        return this->skipped.load();
+    }
+
+    // frames dropped from the queues of slow clients
+    uint64_t getDropped() {
+        return this->dropped.load();
+    }
+};
+
+#endif /* RESULTSERVER_H */
@@ -0,0 +1,203 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef RESULTSNAPSHOT_H
+#define RESULTSNAPSHOT_H
+
+#include <tracker.h>
+#include <contourmoments.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <cstring>
+
+/**
+ * The result of one frame as handed out by SnapshotPublisher: the contour,
+ * the moments of every contour line and, if the publisher keeps it, the
+ * occupancy. Immutable while a reader holds it.
+ */
+class TrackingSnapshot {
+    friend class SnapshotPublisher;
+
+private:
+    Contour contour;
+    std::vector<RegionMoments> regions;
+    int* occu;
+    int width;
+    int height;
+    uint64_t sequence;
+    uint64_t timestamp;
+    std::atomic<uint32_t> users; // readers, plus WRITER while being filled
+
+    TrackingSnapshot(int width, int height, bool withOccupancy) : contour((width + 1) * (height + 1)), occu(withOccupancy ? new int[width * height] : NULL), width(width), height(height), sequence(0), timestamp(0), users(0) {
+    }
+
+    ~TrackingSnapshot() {
+        if (this->occu != NULL) {
+            delete[] this->occu;
+        }
+    }
+
+public:
+
+    const Contour& getContour() const {
+        return this->contour;
+    }
+
+    // one per contour line
+    int getNumberOfRegions() const {
+        return (int) this->regions.size();
+    }
+
+    const RegionMoments& getRegion(int line) const {
+        return this->regions[line];
+    }
+
+    // NULL if the publisher does not keep the occupancy
+    const int* getOccu() const {
+        return this->occu;
+    }
+
+    int getWidth() const {
+        return this->width;
+    }
+
+    int getHeight() const {
+        return this->height;
+    }
+
+    uint64_t getSequence() const {
+        return this->sequence;
+    }
+
+    uint64_t getTimestamp() const {
+        return this->timestamp;
+    }
+};
+
+/**
+ * Publishes tracking results to any number of reader threads.
+ *
+ * The tracker thread copies each frame's result into a free snapshot slot
+ * and makes it the latest with one atomic pointer store. Readers take the
+ * latest snapshot with acquire() and give it back with release(); while
+ * they hold it, the slot is not reused, so they read it in place without
+ * a lock or a copy.
+ *
+ * Every slot counts its readers. The tracker claims a slot by a CAS of the
+ * count from 0 to WRITER, never takes the latest slot, and does not wait:
+ * if readers hold all other slots, the frame is not published and
+ * getSkipped() counts it. With at least two slots more than readers that
+ * happens rarely.
+ */
+class SnapshotPublisher {
+private:
+    static const uint32_t WRITER = 0x80000000u;
+
+    int numSlots;
+    TrackingSnapshot** slots;
+    std::atomic<TrackingSnapshot*> latest;
+    std::atomic<uint64_t> skipped;
+    ContourMoments moments;
+
+public:
+
+    SnapshotPublisher(int width, int height, bool withOccupancy = false, int numSlots = 4) : numSlots(numSlots), slots(new TrackingSnapshot*[numSlots]), latest(NULL), skipped(0) {
+        for (int i = 0; i < numSlots; i++) {
+            this->slots[i] = new TrackingSnapshot(width, height, withOccupancy);
+        }
+    }
+
+    // all snapshots must have been released
+    ~SnapshotPublisher() {
+        for (int i = 0; i < this->numSlots; i++) {
+            delete this->slots[i];
+        }
+        delete[] this->slots;
+    }
+
+    /**
+     * Copies the result of a frame into a snapshot and publishes it. occu
+     * (width * height, may be NULL) is only copied if the publisher keeps the
+     * occupancy. Returns false if no slot was free. Tracker thread only.
+     */
+    bool publish(const Contour& contour, const int* occu, uint64_t sequence, uint64_t timestamp = 0) {
+        TrackingSnapshot* current = this->latest.load(std::memory_order_relaxed);
+        TrackingSnapshot* slot = NULL;
+        for (int i = 0; i < this->numSlots && slot == NULL; i++) {
+            uint32_t expected = 0;
+            if (this->slots[i] != current && this->slots[i]->users.compare_exchange_strong(expected, WRITER, std::memory_order_acquire)) {
+                slot = this->slots[i];
+            }
+        }
+        if (slot == NULL) {
+            this->skipped++;
+            return false;
+        }
+
+        slot->contour.copyFrom(contour);
+        slot->regions.resize(contour.getNumberOfLines());
+        if (!slot->regions.empty()) {
+            this->moments.computeAll(contour, &slot->regions[0]);
+        }
+        if (slot->occu != NULL && occu != NULL) {
+            std::memcpy(slot->occu, occu, slot->width * slot->height * sizeof (int));
+        }
+        slot->sequence = sequence;
+        slot->timestamp = timestamp;
+
+        slot->users.fetch_sub(WRITER, std::memory_order_release);
+        this->latest.store(slot, std::memory_order_release);
+        return true;
+    }
+
+    // latest snapshot, NULL before the first publish(); release() it when done
+    const TrackingSnapshot* acquire() {
+        for (;;) {
+            TrackingSnapshot* slot = this->latest.load(std::memory_order_acquire);
+            if (slot == NULL) {
+                return NULL;
+            }
+            uint32_t users = slot->users.fetch_add(1, std::memory_order_acquire);
+            if ((users & WRITER) == 0 && this->latest.load(std::memory_order_acquire) == slot) {
+                return slot;
+            }
+            // the slot is being reused for a newer frame
+            slot->users.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    void release(const TrackingSnapshot* snapshot) {
+        if (snapshot != NULL) {
+            const_cast<TrackingSnapshot*> (snapshot)->users.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    // frames not published because readers held every slot
+    uint64_t getSkipped() {
+        return this->skipped.load();
+    }
+
+    int getNumberOfSlots() {
+        return this->numSlots;
+    }
+};
+
+#endif /* RESULTSNAPSHOT_H */
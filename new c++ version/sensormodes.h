@@ -0,0 +1,46 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SENSORMODES_H
+#define SENSORMODES_H
+
+#include <config.h>
+#include <tracker.h>
+#include <KinectHomogeneity.h>
+
+/**
+ * Instantiations for the sensor modes we ship, with the frame geometry and
+ * the default seed spacing fixed at compile time. Tracker<HOMOGENEITY> and
+ * KinectHomogeneity<BACKGROUNDMODEL> stay the runtime sized fallback.
+ */
+
+// Kinect v1, 640x480
+template <typename HOMOGENEITY, bool PADDED = false> using KinectTracker = Tracker<HOMOGENEITY, PADDED, 640, 480, SEED_SPACING_X, SEED_SPACING_Y>;
+template <typename BACKGROUNDMODEL> using KinectHomogeneity640x480 = KinectHomogeneity<BACKGROUNDMODEL, 640, 480>;
+
+// Kinect v2, 512x424
+template <typename HOMOGENEITY, bool PADDED = false> using Kinect2Tracker = Tracker<HOMOGENEITY, PADDED, 512, 424, SEED_SPACING_X, SEED_SPACING_Y>;
+template <typename BACKGROUNDMODEL> using KinectHomogeneity512x424 = KinectHomogeneity<BACKGROUNDMODEL, 512, 424>;
+
+// 720p
+template <typename HOMOGENEITY, bool PADDED = false> using Tracker1280x720 = Tracker<HOMOGENEITY, PADDED, 1280, 720, SEED_SPACING_X, SEED_SPACING_Y>;
+template <typename BACKGROUNDMODEL> using KinectHomogeneity1280x720 = KinectHomogeneity<BACKGROUNDMODEL, 1280, 720>;
+
+#endif /* SENSORMODES_H */
@@ -0,0 +1,228 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ
+ * email: christ_o@gmx.de
+ *
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHAPEDESCRIPTOR_H
+#define SHAPEDESCRIPTOR_H
+
+#include <contourresampler.h>
+#include <cmath>
+
+/**
+ * Normalized elliptic Fourier descriptors of resampled contour lines.
+ *
+ * The samplerate points of a line are taken as one complex signal x + iy and
+ * transformed with a radix-2 FFT whose twiddle factors and bit reversal
+ * permutation are computed once in the constructor. The elliptic
+ * coefficients (a, b, c, d) of harmonics 1..getHarmonics() are read off the
+ * spectrum and normalized the usual way (Kuhl and Giardina): the DC term is
+ * dropped for translation, the first harmonic is rotated to a fixed phase and
+ * orientation and its semi-major axis is scaled to 1.
+ *
+ * A descriptor has 4 * getHarmonics() floats, a, b, c, d per harmonic.
+ * samplerate has to be a power of two, see isValid().
+ */
+class ShapeDescriptor {
+private:
+    int samplerate;
+    int harmonics;
+    int levels;
+    int* reversed;
+    float* twiddleRe;
+    float* twiddleIm;
+    float* re;
+    float* im;
+    double* coefficients;
+
+    void fft() {
+        for (int i = 0; i < this->samplerate; i++) {
+            int j = this->reversed[i];
+            if (j > i) {
+                float t = this->re[i];
+                this->re[i] = this->re[j];
+                this->re[j] = t;
+                t = this->im[i];
+                this->im[i] = this->im[j];
+                this->im[j] = t;
+            }
+        }
+
+        for (int half = 1, stride = this->samplerate / 2; half < this->samplerate; half *= 2, stride /= 2) {
+            for (int block = 0; block < this->samplerate; block += 2 * half) {
+                for (int k = 0; k < half; k++) {
+                    float wr = this->twiddleRe[k * stride];
+                    float wi = this->twiddleIm[k * stride];
+                    int a = block + k;
+                    int b = a + half;
+                    float tr = wr * this->re[b] - wi * this->im[b];
+                    float ti = wr * this->im[b] + wi * this->re[b];
+                    this->re[b] = this->re[a] - tr;
+                    this->im[b] = this->im[a] - ti;
+                    this->re[a] += tr;
+                    this->im[a] += ti;
+                }
+            }
+        }
+    }
+
+public:
+
+    ShapeDescriptor(int samplerate, int harmonics) : samplerate(samplerate), harmonics(harmonics), levels(0), reversed(NULL), twiddleRe(NULL), twiddleIm(NULL), re(NULL), im(NULL), coefficients(new double[4 * harmonics]) {
+        while ((1 << this->levels) < samplerate) {
+            this->levels++;
+        }
+        if (!isValid()) {
+            return;
+        }
+
+        this->reversed = new int[samplerate];
+        for (int i = 0; i < samplerate; i++) {
+            int r = 0;
+            for (int b = 0; b < this->levels; b++) {
+                r |= ((i >> b) & 1) << (this->levels - 1 - b);
+            }
+            this->reversed[i] = r;
+        }
+
+        this->twiddleRe = new float[samplerate / 2];
+        this->twiddleIm = new float[samplerate / 2];
+        for (int k = 0; k < samplerate / 2; k++) {
+            double angle = -2.0 * M_PI * k / samplerate;
+            this->twiddleRe[k] = (float) std::cos(angle);
+            this->twiddleIm[k] = (float) std::sin(angle);
+        }
+
+        this->re = new float[samplerate];
+        this->im = new float[samplerate];
+    }
+
+    ~ShapeDescriptor() {
+        delete[] this->reversed;
+        delete[] this->twiddleRe;
+        delete[] this->twiddleIm;
+        delete[] this->re;
+        delete[] this->im;
+        delete[] this->coefficients;
+    }
+
+    // samplerate is a power of two and large enough for the harmonics
+    bool isValid() const {
+        return this->samplerate >= 4 && (1 << this->levels) == this->samplerate && this->harmonics > 0 && this->harmonics < this->samplerate / 2;
+    }
+
+    const int& getHarmonics() const {
+        return this->harmonics;
+    }
+
+    int getDescriptorSize() const {
+        return 4 * this->harmonics;
+    }
+
+    /**
+     * Descriptor of one line of samplerate points. Returns false for
+     * degenerate lines, which get an all zero descriptor.
+     */
+    bool compute(const float* x, const float* y, float* descriptor) {
+        const int size = getDescriptorSize();
+        for (int i = 0; i < size; i++) {
+            descriptor[i] = 0;
+        }
+        if (!isValid()) {
+            return false;
+        }
+
+        for (int i = 0; i < this->samplerate; i++) {
+            this->re[i] = x[i];
+            this->im[i] = y[i];
+        }
+        fft();
+
+        // split the spectrum of x + iy into the spectra of x and y
+        const double scale = 1.0 / this->samplerate;
+        double* c = this->coefficients;
+        for (int n = 1; n <= this->harmonics; n++) {
+            int m = this->samplerate - n;
+            double xr = 0.5 * (this->re[n] + this->re[m]);
+            double xi = 0.5 * (this->im[n] - this->im[m]);
+            double yr = 0.5 * (this->im[n] + this->im[m]);
+            double yi = -0.5 * (this->re[n] - this->re[m]);
+            c[4 * (n - 1) + 0] = 2 * xr * scale;
+            c[4 * (n - 1) + 1] = -2 * xi * scale;
+            c[4 * (n - 1) + 2] = 2 * yr * scale;
+            c[4 * (n - 1) + 3] = -2 * yi * scale;
+        }
+
+        double a1 = c[0], b1 = c[1], c1 = c[2], d1 = c[3];
+        double theta = 0.5 * std::atan2(2 * (a1 * b1 + c1 * d1), a1 * a1 - b1 * b1 + c1 * c1 - d1 * d1);
+
+        // start point: shift every harmonic by n * theta
+        for (int n = 1; n <= this->harmonics; n++) {
+            double* h = c + 4 * (n - 1);
+            double cs = std::cos(n * theta);
+            double sn = std::sin(n * theta);
+            double a = h[0] * cs + h[1] * sn;
+            double b = -h[0] * sn + h[1] * cs;
+            double cc = h[2] * cs + h[3] * sn;
+            double d = -h[2] * sn + h[3] * cs;
+            h[0] = a;
+            h[1] = b;
+            h[2] = cc;
+            h[3] = d;
+        }
+
+        // rotation: align the major axis of the first harmonic with x
+        double psi = std::atan2(c[2], c[0]);
+        double cs = std::cos(psi);
+        double sn = std::sin(psi);
+        double major = c[0] * cs + c[2] * sn;
+        if (std::fabs(major) < 1e-12) {
+            return false;
+        }
+
+        for (int n = 1; n <= this->harmonics; n++) {
+            double* h = c + 4 * (n - 1);
+            double a = h[0] * cs + h[2] * sn;
+            double b = h[1] * cs + h[3] * sn;
+            double cc = -h[0] * sn + h[2] * cs;
+            double d = -h[1] * sn + h[3] * cs;
+            descriptor[4 * (n - 1) + 0] = (float) (a / std::fabs(major));
+            descriptor[4 * (n - 1) + 1] = (float) (b / std::fabs(major));
+            descriptor[4 * (n - 1) + 2] = (float) (cc / std::fabs(major));
+            descriptor[4 * (n - 1) + 3] = (float) (d / std::fabs(major));
+        }
+        return true;
+    }
+
+    /**
+     * Descriptors of all lines in one batch, written one after another into
+     * descriptors (getNumberOfLines() * getDescriptorSize() floats). Returns
+     * the number of lines, or 0 if the sample rate of the input does not match.
+     */
+    int computeAll(const ResampledContours& in, float* descriptors) {
+        if (in.getSampleRate() != this->samplerate) {
+            return 0;
+        }
+        const int size = getDescriptorSize();
+        for (int l = 0; l < in.getNumberOfLines(); l++) {
+            compute(in.getX(l), in.getY(l), descriptors + l * size);
+        }
+        return in.getNumberOfLines();
+    }
+};
+
+#endif /* SHAPEDESCRIPTOR_H */
@@ -0,0 +1,251 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SHAREDRESULTS_H
+#define SHAREDRESULTS_H
+
+#include <stdint.h>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Layout of the POSIX shared memory ring written by SharedResultsPublisher,
+ * and SharedResultsReader for the processes that read it. This header does
+ * not depend on the tracker, consumers only need it (and -lrt on older
+ * glibc).
+ *
+ * The memory starts with a SharedResultsHeader, followed by numSlots slots
+ * of slotSize bytes. Frame n goes to slot n % numSlots. A slot starts with a
+ * SharedResultsSlot, followed at the header's offsets by
+ *   numPoints x, y pairs of int16_t
+ *   numLines + 1 int32_t line offsets (line i is points [lines[i], lines[i + 1]))
+ *   numLines SharedRegion, the statistics of every line
+ *   the occupancy as a bitmap, bit i % 8 of byte i / 8 for pixel i, if
+ *   hasOccupancy
+ * Every slot is guarded by a sequence lock: lock is odd while the publisher
+ * writes the slot and is incremented again when it is done.
+ */
+class SharedResultsHeader {
+public:
+    char magic[8]; // "TBGSHM1"
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t numSlots;
+    uint64_t slotSize;
+    int32_t maxPoints;
+    int32_t maxLines;
+    int32_t hasOccupancy;
+    uint32_t pointsOffset;
+    uint32_t linesOffset;
+    uint32_t regionsOffset;
+    uint32_t occupancyOffset;
+    uint32_t reserved;
+    uint64_t latest; // sequence number of the last complete frame + 1, 0 for none
+};
+
+class SharedResultsSlot {
+public:
+    uint64_t lock;
+    uint64_t sequence;
+    uint64_t timestamp;
+    int32_t numPoints;
+    int32_t numLines;
+    int32_t truncated; // contour did not fit, lines were left out
+    int32_t reserved;
+};
+
+class SharedRegion {
+public:
+    int64_t signedArea; // > 0 for outer boundaries, < 0 for holes
+    float cx;
+    float cy;
+    float orientation; // of the major axis, radians
+    int32_t x0, y0, x1, y1; // bounding box of the line's points
+};
+
+/**
+ * Where a frame lies in the ring. Points into the shared memory; the data
+ * is only known to be consistent if validate() returns true after it has
+ * been read.
+ */
+class SharedFrameView {
+public:
+    const SharedResultsSlot* slot;
+    uint64_t lock;
+    uint64_t sequence;
+    uint64_t timestamp;
+    int numPoints;
+    int numLines;
+    bool truncated;
+    const int16_t* points;
+    const int32_t* lines;
+    const SharedRegion* regions;
+    const uint8_t* occupancy; // NULL if not published
+
+    SharedFrameView() : slot(NULL), lock(0), sequence(0), timestamp(0), numPoints(0), numLines(0), truncated(false), points(NULL), lines(NULL), regions(NULL), occupancy(NULL) {
+    }
+
+    int getX(const int& index) const {
+        return this->points[2 * index];
+    }
+
+    int getY(const int& index) const {
+        return this->points[2 * index + 1];
+    }
+
+    bool isOccupied(const int& index) const {
+        return (this->occupancy[index >> 3] >> (index & 7)) & 1;
+    }
+};
+
+class SharedResultsReader {
+private:
+    void* mapping;
+    size_t size;
+    const SharedResultsHeader* header;
+
+    // offsets in order and inside the slot, all slots inside the mapping
+    static bool isValid(const SharedResultsHeader* h, const size_t& size) {
+        if (std::memcmp(h->magic, "TBGSHM1", 8) != 0 || h->version != 1) {
+            return false;
+        }
+        if (h->width <= 0 || h->height <= 0 || h->numSlots <= 0 || h->maxPoints < 0 || h->maxLines < 0) {
+            return false;
+        }
+        uint64_t occupancySize = h->hasOccupancy ? ((uint64_t) h->width * h->height + 7) / 8 : 0;
+        if (h->pointsOffset < sizeof (SharedResultsSlot)
+                || h->linesOffset < h->pointsOffset + 2 * (uint64_t) h->maxPoints * sizeof (int16_t)
+                || h->regionsOffset < h->linesOffset + ((uint64_t) h->maxLines + 1) * sizeof (int32_t)
+                || h->occupancyOffset < h->regionsOffset + (uint64_t) h->maxLines * sizeof (SharedRegion)
+                || h->slotSize < h->occupancyOffset + occupancySize) {
+            return false;
+        }
+        return h->slotSize <= (size - sizeof (SharedResultsHeader)) / h->numSlots;
+    }
+
+    const uint8_t* slotAt(const int& index) const {
+        return (const uint8_t*) this->mapping + sizeof (SharedResultsHeader) + index * this->header->slotSize;
+    }
+
+public:
+
+    SharedResultsReader() : mapping(NULL), size(0), header(NULL) {
+    }
+
+    ~SharedResultsReader() {
+        close();
+    }
+
+    // maps the ring name (e.g. "/tracker") read-only
+    bool open(const char* name) {
+        close();
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof (SharedResultsHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void* data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+
+        const SharedResultsHeader* h = (const SharedResultsHeader*) data;
+        if (!isValid(h, info.st_size)) {
+            munmap(data, info.st_size);
+            return false;
+        }
+        this->mapping = data;
+        this->size = info.st_size;
+        this->header = h;
+        return true;
+    }
+
+    void close() {
+        if (this->mapping != NULL) {
+            munmap(this->mapping, this->size);
+            this->mapping = NULL;
+            this->header = NULL;
+        }
+    }
+
+    bool isOpen() const {
+        return this->header != NULL;
+    }
+
+    const SharedResultsHeader* getHeader() const {
+        return this->header;
+    }
+
+    // sequence number of the last complete frame + 1, 0 before the first one
+    uint64_t getLatest() const {
+        return __atomic_load_n(&this->header->latest, __ATOMIC_ACQUIRE);
+    }
+
+    /**
+     * Points view at frame sequence, or at the latest frame if sequence is
+     * negative. Returns false if the frame is not (or no longer) in the ring
+     * or is being written.
+     */
+    bool acquire(SharedFrameView& view, int64_t sequence = -1) const {
+        uint64_t latest = getLatest();
+        if (latest == 0) {
+            return false;
+        }
+        uint64_t wanted = sequence < 0 ? latest - 1 : (uint64_t) sequence;
+        const uint8_t* base = slotAt((int) (wanted % this->header->numSlots));
+        const SharedResultsSlot* slot = (const SharedResultsSlot*) base;
+
+        view.slot = slot;
+        view.lock = __atomic_load_n(&slot->lock, __ATOMIC_ACQUIRE);
+        if ((view.lock & 1) != 0 || slot->sequence != wanted) {
+            return false;
+        }
+        view.sequence = slot->sequence;
+        view.timestamp = slot->timestamp;
+        view.numPoints = slot->numPoints;
+        view.numLines = slot->numLines;
+        if (view.numPoints < 0 || view.numPoints > this->header->maxPoints || view.numLines < 0 || view.numLines > this->header->maxLines) {
+            return false;
+        }
+        view.truncated = slot->truncated != 0;
+        view.points = (const int16_t*) (base + this->header->pointsOffset);
+        view.lines = (const int32_t*) (base + this->header->linesOffset);
+        view.regions = (const SharedRegion*) (base + this->header->regionsOffset);
+        view.occupancy = this->header->hasOccupancy ? base + this->header->occupancyOffset : NULL;
+        return validate(view);
+    }
+
+    // true if the slot has not been rewritten since acquire()
+    bool validate(const SharedFrameView& view) const {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&view.slot->lock, __ATOMIC_RELAXED) == view.lock;
+    }
+};
+
+#endif /* SHAREDRESULTS_H */
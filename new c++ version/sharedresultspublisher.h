@@ -0,0 +1,201 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SHAREDRESULTSPUBLISHER_H
+#define SHAREDRESULTSPUBLISHER_H
+
+#include <sharedresults.h>
+#include <tracker.h>
+#include <contourmoments.h>
+#include <string>
+
+/**
+ * Writes the result of every frame into a POSIX shared memory ring that
+ * other processes read with SharedResultsReader, see sharedresults.h.
+ *
+ * Contours with more than maxPoints points or maxLines lines are cut at a
+ * line boundary and marked truncated. The publisher creates the shared
+ * memory object and removes its name again when destroyed; readers that
+ * have it mapped keep their mapping.
+ */
+class SharedResultsPublisher {
+private:
+    std::string name;
+    void* mapping;
+    size_t size;
+    SharedResultsHeader* header;
+    ContourMoments moments;
+    RegionMoments region;
+
+    static uint32_t align(size_t value) {
+        return (uint32_t) ((value + 63) / 64 * 64);
+    }
+
+    uint8_t* slotAt(const int& index) const {
+        return (uint8_t*) this->mapping + sizeof (SharedResultsHeader) + index * this->header->slotSize;
+    }
+
+public:
+
+    SharedResultsPublisher() : mapping(NULL), size(0), header(NULL) {
+    }
+
+    ~SharedResultsPublisher() {
+        close();
+    }
+
+    bool open(const char* name, int width, int height, int maxPoints, int maxLines, int numSlots = 4, bool withOccupancy = false) {
+        close();
+
+        SharedResultsHeader h;
+        std::memset(&h, 0, sizeof (h));
+        std::memcpy(h.magic, "TBGSHM1", 8);
+        h.version = 1;
+        h.width = width;
+        h.height = height;
+        h.numSlots = numSlots;
+        h.maxPoints = maxPoints;
+        h.maxLines = maxLines;
+        h.hasOccupancy = withOccupancy;
+        h.pointsOffset = align(sizeof (SharedResultsSlot));
+        h.linesOffset = align(h.pointsOffset + 2 * maxPoints * sizeof (int16_t));
+        h.regionsOffset = align(h.linesOffset + (maxLines + 1) * sizeof (int32_t));
+        h.occupancyOffset = align(h.regionsOffset + maxLines * sizeof (SharedRegion));
+        h.slotSize = align(h.occupancyOffset + (withOccupancy ? (width * height + 7) / 8 : 0));
+        h.latest = 0;
+
+        size_t total = sizeof (SharedResultsHeader) + numSlots * h.slotSize;
+        // a stale segment of a crashed publisher may have another size or readers still mapped
+        shm_unlink(name);
+        int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        if (ftruncate(fd, total) != 0) {
+            ::close(fd);
+            shm_unlink(name);
+            return false;
+        }
+        void* data = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            shm_unlink(name);
+            return false;
+        }
+
+        std::memset(data, 0, total);
+        std::memcpy(data, &h, sizeof (h));
+        this->name = name;
+        this->mapping = data;
+        this->size = total;
+        this->header = (SharedResultsHeader*) data;
+        return true;
+    }
+
+    void close() {
+        if (this->mapping != NULL) {
+            munmap(this->mapping, this->size);
+            shm_unlink(this->name.c_str());
+            this->mapping = NULL;
+            this->header = NULL;
+        }
+    }
+
+    /**
+     * Publishes a frame. occu (width * height) is only used if the ring was
+     * opened with occupancy and may be NULL otherwise.
+     */
+    bool publish(const Contour& contour, const int* occu, uint64_t sequence, uint64_t timestamp = 0) {
+        if (this->header == NULL) {
+            return false;
+        }
+        const SharedResultsHeader& h = *this->header;
+        uint8_t* base = slotAt((int) (sequence % h.numSlots));
+        SharedResultsSlot* slot = (SharedResultsSlot*) base;
+
+        uint64_t lock = __atomic_load_n(&slot->lock, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->lock, lock + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        int16_t* points = (int16_t*) (base + h.pointsOffset);
+        int32_t* lines = (int32_t*) (base + h.linesOffset);
+        SharedRegion* regions = (SharedRegion*) (base + h.regionsOffset);
+
+        int numLines = 0;
+        int numPoints = 0;
+        lines[0] = 0;
+        for (int l = 0; l < contour.getNumberOfLines() && numLines < h.maxLines; l++) {
+            int start = contour.lineStart(l);
+            int end = contour.lineEnd(l);
+            if (numPoints + end - start > h.maxPoints) {
+                break;
+            }
+
+            SharedRegion& r = regions[numLines];
+            r.x0 = r.y0 = INT32_MAX;
+            r.x1 = r.y1 = INT32_MIN;
+            for (int i = start; i < end; i++) {
+                int x = contour.getX(i);
+                int y = contour.getY(i);
+                points[2 * numPoints] = (int16_t) x;
+                points[2 * numPoints + 1] = (int16_t) y;
+                numPoints++;
+                r.x0 = x < r.x0 ? x : r.x0;
+                r.y0 = y < r.y0 ? y : r.y0;
+                r.x1 = x > r.x1 ? x : r.x1;
+                r.y1 = y > r.y1 ? y : r.y1;
+            }
+            this->moments.compute(contour, start, end, this->region);
+            r.signedArea = this->region.signedArea;
+            r.cx = (float) this->region.cx;
+            r.cy = (float) this->region.cy;
+            r.orientation = (float) this->region.getOrientation();
+            lines[++numLines] = numPoints;
+        }
+
+        if (h.hasOccupancy && occu != NULL) {
+            uint8_t* bits = base + h.occupancyOffset;
+            const int pixels = h.width * h.height;
+            for (int i = 0; i < pixels; i += 8) {
+                uint8_t byte = 0;
+                for (int b = 0; b < 8 && i + b < pixels; b++) {
+                    byte |= (occu[i + b] != 0) << b;
+                }
+                bits[i >> 3] = byte;
+            }
+        }
+
+        slot->sequence = sequence;
+        slot->timestamp = timestamp;
+        slot->numPoints = numPoints;
+        slot->numLines = numLines;
+        slot->truncated = numLines < contour.getNumberOfLines();
+
+        __atomic_store_n(&slot->lock, lock + 2, __ATOMIC_RELEASE);
+        __atomic_store_n(&this->header->latest, sequence + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    bool isOpen() {
+        return this->header != NULL;
+    }
+};
+
+#endif /* SHAREDRESULTSPUBLISHER_H */
@@ -0,0 +1,518 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRACKASSOCIATOR_H
+#define TRACKASSOCIATOR_H
+
+#include <tracker.h>
+#include <contourmoments.h>
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+/**
+ * A region that has been followed across frames.
+ */
+class Track {
+public:
+    int id;
+    int age; // frames since the track was created
+    int missed; // frames in a row without a matching region
+    int line; // contour line of the region in the current frame, -1 if missed
+    float cx, cy; // centroid
+    float vx, vy; // smoothed velocity in pixels per frame
+    int64_t area;
+    int x0, y0, x1, y1; // axis aligned bounding box
+
+    float predictedX() const {
+        return this->cx + this->vx;
+    }
+
+    float predictedY() const {
+        return this->cy + this->vy;
+    }
+};
+
+/**
+ * Gives the regions of consecutive frames persistent ids.
+ *
+ * The outer contour lines of a frame are rasterized into a coarse label grid
+ * (one sample per cellSize x cellSize cell, counted only where the tracker's
+ * occupancy is set). As drops survive shrink(), a region usually covers most
+ * of the cells its track covered in the previous frame, so the first step
+ * counts, for every cell, the overlap of last frame's track and this frame's
+ * region. A track and a region that overlap each other and nothing else are
+ * matched directly.
+ *
+ * Everything else (splits, merges, regions that moved further than their
+ * size, new and vanished regions) is ambiguous. For those the cost of a pair
+ * is the distance between the track's predicted centroid and the region's
+ * centroid plus the difference of their bounding box sizes; pairs above
+ * maxDistance are not allowed unless they overlap. The assignment with the
+ * least total cost is found with the Hungarian method, so the cost is cubic
+ * in the number of ambiguous regions only; above maxAssignment of them a
+ * greedy assignment by increasing cost is used instead.
+ *
+ * Unmatched regions start new tracks, tracks that are not matched for more
+ * than maxMissed frames are removed.
+ */
+class TrackAssociator {
+private:
+    class Region {
+    public:
+        int line;
+        float cx, cy;
+        int64_t area;
+        int x0, y0, x1, y1;
+        int track; // index into tracks, -1 until matched
+    };
+
+    class AreaOrder {
+    public:
+        const std::vector<Region>& regions;
+
+        AreaOrder(const std::vector<Region>& regions) : regions(regions) {
+        }
+
+        bool operator()(const int& a, const int& b) const {
+            return this->regions[a].area > this->regions[b].area;
+        }
+    };
+
+    int width, height;
+    int cellSize;
+    int cellsX, cellsY;
+    int nextId;
+    int minContourLength;
+    int maxMissed;
+    int maxAssignment;
+    float maxDistance;
+    float smoothing;
+    std::vector<Track> tracks;
+    std::vector<Region> regions;
+    std::vector<int> labels; // region per cell, this frame
+    std::vector<int> previous; // track per cell, last frame
+    std::vector<int> lineIds;
+    std::vector<int64_t> crossings;
+    std::vector<int> order;
+    std::vector<int64_t> votes;
+    std::vector<int> trackDegree, regionDegree;
+    std::vector<int> trackPartner, regionPartner;
+    ContourMoments moments;
+    RegionMoments region;
+
+    // Hungarian method, assignment of the rows to distinct columns, rows <= columns
+    std::vector<double> u, v, minv;
+    std::vector<int> p, way, assignment;
+    std::vector<char> used;
+
+    void assign(const std::vector<double>& cost, const int& rows, const int& columns) {
+        const double INF = 1e18;
+        this->u.assign(rows + 1, 0);
+        this->v.assign(columns + 1, 0);
+        this->p.assign(columns + 1, 0);
+        this->way.assign(columns + 1, 0);
+        for (int i = 1; i <= rows; i++) {
+            this->p[0] = i;
+            int j0 = 0;
+            this->minv.assign(columns + 1, INF);
+            this->used.assign(columns + 1, 0);
+            do {
+                this->used[j0] = 1;
+                int i0 = this->p[j0], j1 = 0;
+                double delta = INF;
+                for (int j = 1; j <= columns; j++) {
+                    if (!this->used[j]) {
+                        double cur = cost[(i0 - 1) * columns + j - 1] - this->u[i0] - this->v[j];
+                        if (cur < this->minv[j]) {
+                            this->minv[j] = cur;
+                            this->way[j] = j0;
+                        }
+                        if (this->minv[j] < delta) {
+                            delta = this->minv[j];
+                            j1 = j;
+                        }
+                    }
+                }
+                for (int j = 0; j <= columns; j++) {
+                    if (this->used[j]) {
+                        this->u[this->p[j]] += delta;
+                        this->v[j] -= delta;
+                    } else {
+                        this->minv[j] -= delta;
+                    }
+                }
+                j0 = j1;
+            } while (this->p[j0] != 0);
+            do {
+                int j1 = this->way[j0];
+                this->p[j0] = this->p[j1];
+                j0 = j1;
+            } while (j0 != 0);
+        }
+        this->assignment.assign(rows, -1);
+        for (int j = 1; j <= columns; j++) {
+            if (this->p[j] != 0) {
+                this->assignment[this->p[j] - 1] = j - 1;
+            }
+        }
+    }
+
+    void collectRegions(const Contour& contour) {
+        this->regions.clear();
+        for (int l = 0; l < contour.getNumberOfLines(); l++) {
+            const int start = contour.lineStart(l);
+            const int end = contour.lineEnd(l);
+            if (end - start < this->minContourLength || end - start < 3) {
+                continue;
+            }
+            this->moments.compute(contour, start, end, this->region);
+            if (this->region.signedArea <= 0) {
+                continue; // holes belong to the region around them
+            }
+            Region r;
+            r.line = l;
+            r.cx = (float) this->region.cx;
+            r.cy = (float) this->region.cy;
+            r.area = this->region.signedArea;
+            r.x0 = r.x1 = contour.getX(start);
+            r.y0 = r.y1 = contour.getY(start);
+            for (int i = start + 1; i < end; i++) {
+                r.x0 = std::min(r.x0, contour.getX(i));
+                r.y0 = std::min(r.y0, contour.getY(i));
+                r.x1 = std::max(r.x1, contour.getX(i));
+                r.y1 = std::max(r.y1, contour.getY(i));
+            }
+            r.track = -1;
+            this->regions.push_back(r);
+        }
+    }
+
+    /**
+     * Even-odd fill of the outer lines at the cell samples. The contour runs
+     * along pixel corners, a vertical step from (x, y) to (x, y + 1) crosses
+     * the centre of pixel row y. Larger regions are filled first, so regions
+     * inside holes of others keep their label.
+     */
+    void rasterize(const Contour& contour, const int* occu) {
+        std::fill(this->labels.begin(), this->labels.end(), -1);
+        const int s = this->cellSize;
+        const int half = s / 2;
+
+        this->order.resize(this->regions.size());
+        for (size_t i = 0; i < this->order.size(); i++) {
+            this->order[i] = (int) i;
+        }
+        std::sort(this->order.begin(), this->order.end(), AreaOrder(this->regions));
+
+        for (size_t k = 0; k < this->order.size(); k++) {
+            const int index = this->order[k];
+            const int start = contour.lineStart(this->regions[index].line);
+            const int end = contour.lineEnd(this->regions[index].line);
+
+            this->crossings.clear();
+            for (int i = start; i < end; i++) {
+                const int j = i + 1 < end ? i + 1 : start;
+                const int ya = contour.getY(i), yb = contour.getY(j);
+                if (contour.getX(i) != contour.getX(j) || ya == yb) {
+                    continue;
+                }
+                const int y = std::min(ya, yb);
+                if (y % s == half && y / s < this->cellsY) {
+                    this->crossings.push_back(((int64_t) (y / s) << 32) | contour.getX(i));
+                }
+            }
+            std::sort(this->crossings.begin(), this->crossings.end());
+
+            for (size_t c = 0; c + 1 < this->crossings.size(); c += 2) {
+                const int cy = (int) (this->crossings[c] >> 32);
+                const int xa = (int) (this->crossings[c] & 0xffffffff);
+                const int xb = (int) (this->crossings[c + 1] & 0xffffffff);
+                const int py = cy * s + half;
+                // cells whose sample column lies in [xa, xb)
+                for (int cx = (xa - half + s - 1) / s; cx < this->cellsX && cx * s + half < xb; cx++) {
+                    if (occu[py * this->width + cx * s + half] > 0) {
+                        this->labels[cy * this->cellsX + cx] = index;
+                    }
+                }
+            }
+        }
+    }
+
+    // overlap of last frame's tracks with this frame's regions
+    void vote() {
+        const int numRegions = (int) this->regions.size();
+        this->votes.clear();
+        for (size_t i = 0; i < this->labels.size(); i++) {
+            if (this->previous[i] >= 0 && this->labels[i] >= 0) {
+                this->votes.push_back((int64_t) this->previous[i] * numRegions + this->labels[i]);
+            }
+        }
+        std::sort(this->votes.begin(), this->votes.end());
+        this->votes.erase(std::unique(this->votes.begin(), this->votes.end()), this->votes.end());
+
+        this->trackDegree.assign(this->tracks.size(), 0);
+        this->regionDegree.assign(numRegions, 0);
+        this->trackPartner.assign(this->tracks.size(), -1);
+        this->regionPartner.assign(numRegions, -1);
+        for (size_t k = 0; k < this->votes.size(); k++) {
+            const int t = (int) (this->votes[k] / numRegions);
+            const int r = (int) (this->votes[k] % numRegions);
+            this->trackDegree[t]++;
+            this->regionDegree[r]++;
+            this->trackPartner[t] = r;
+            this->regionPartner[r] = t;
+        }
+    }
+
+    bool overlaps(const int& track, const int& region) const {
+        const int64_t key = (int64_t) track * this->regions.size() + region;
+        return std::binary_search(this->votes.begin(), this->votes.end(), key);
+    }
+
+    double cost(const Track& t, const Region& r) const {
+        const double dx = t.predictedX() - r.cx;
+        const double dy = t.predictedY() - r.cy;
+        const double size = std::fabs((double) (t.x1 - t.x0) - (r.x1 - r.x0)) + std::fabs((double) (t.y1 - t.y0) - (r.y1 - r.y0));
+        return std::sqrt(dx * dx + dy * dy) + 0.5 * size;
+    }
+
+    void match(const int& t, const int& r) {
+        Track& track = this->tracks[t];
+        Region& region = this->regions[r];
+        const float a = this->smoothing;
+        track.vx = a * (region.cx - track.cx) + (1 - a) * track.vx;
+        track.vy = a * (region.cy - track.cy) + (1 - a) * track.vy;
+        track.cx = region.cx;
+        track.cy = region.cy;
+        track.area = region.area;
+        track.x0 = region.x0;
+        track.y0 = region.y0;
+        track.x1 = region.x1;
+        track.y1 = region.y1;
+        track.line = region.line;
+        track.missed = 0;
+        region.track = t;
+    }
+
+    void resolveAmbiguous() {
+        std::vector<int> openTracks, openRegions;
+        for (size_t t = 0; t < this->tracks.size(); t++) {
+            if (this->tracks[t].line < 0) {
+                openTracks.push_back((int) t);
+            }
+        }
+        for (size_t r = 0; r < this->regions.size(); r++) {
+            if (this->regions[r].track < 0) {
+                openRegions.push_back((int) r);
+            }
+        }
+        if (openTracks.empty() || openRegions.empty()) {
+            return;
+        }
+
+        // infeasible pairs get a cost no feasible assignment reaches
+        const int nt = (int) openTracks.size(), nr = (int) openRegions.size();
+        const double blocked = 1e9;
+        std::vector<double> costs(nt * nr);
+        for (int i = 0; i < nt; i++) {
+            for (int j = 0; j < nr; j++) {
+                double c = cost(this->tracks[openTracks[i]], this->regions[openRegions[j]]);
+                bool allowed = c <= this->maxDistance || overlaps(openTracks[i], openRegions[j]);
+                costs[i * nr + j] = allowed ? c : blocked;
+            }
+        }
+
+        if (std::max(nt, nr) > this->maxAssignment) {
+            std::vector<std::pair<double, int> > pairs;
+            for (int k = 0; k < nt * nr; k++) {
+                if (costs[k] < blocked) {
+                    pairs.push_back(std::make_pair(costs[k], k));
+                }
+            }
+            std::sort(pairs.begin(), pairs.end());
+            for (size_t k = 0; k < pairs.size(); k++) {
+                const int t = openTracks[pairs[k].second / nr];
+                const int r = openRegions[pairs[k].second % nr];
+                if (this->tracks[t].line < 0 && this->regions[r].track < 0) {
+                    match(t, r);
+                }
+            }
+            return;
+        }
+
+        // the method wants rows <= columns
+        const bool transposed = nt > nr;
+        const int rows = transposed ? nr : nt, columns = transposed ? nt : nr;
+        std::vector<double> square(rows * columns);
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < columns; j++) {
+                square[i * columns + j] = transposed ? costs[j * nr + i] : costs[i * nr + j];
+            }
+        }
+        assign(square, rows, columns);
+        for (int i = 0; i < rows; i++) {
+            const int j = this->assignment[i];
+            if (j < 0 || square[i * columns + j] >= blocked) {
+                continue;
+            }
+            match(openTracks[transposed ? j : i], openRegions[transposed ? i : j]);
+        }
+    }
+
+public:
+
+    TrackAssociator(int width, int height, int cellSize = 8) : width(width), height(height), cellSize(cellSize), cellsX((width + cellSize - 1 - cellSize / 2) / cellSize), cellsY((height + cellSize - 1 - cellSize / 2) / cellSize), nextId(0), minContourLength(3), maxMissed(5), maxAssignment(64), maxDistance(80.0f), smoothing(0.5f), labels(cellsX * cellsY, -1), previous(cellsX * cellsY, -1) {
+    }
+
+    /**
+     * Associates the outer contour lines of a frame with the tracks. occu is
+     * the tracker's dense width x height grid, see Tracker::getOccu().
+     */
+    const std::vector<Track>& update(const Contour& contour, const int* occu) {
+        collectRegions(contour);
+        rasterize(contour, occu);
+        vote();
+
+        for (size_t t = 0; t < this->tracks.size(); t++) {
+            this->tracks[t].line = -1;
+        }
+        for (size_t r = 0; r < this->regions.size(); r++) {
+            const int t = this->regionPartner[r];
+            if (this->regionDegree[r] == 1 && this->trackDegree[t] == 1) {
+                match(t, (int) r);
+            }
+        }
+        resolveAmbiguous();
+
+        // coast or remove the unmatched tracks
+        size_t kept = 0;
+        std::vector<int> remap(this->tracks.size(), -1);
+        for (size_t t = 0; t < this->tracks.size(); t++) {
+            Track& track = this->tracks[t];
+            if (track.line < 0) {
+                track.missed++;
+                track.cx += track.vx;
+                track.cy += track.vy;
+            }
+            track.age++;
+            if (track.missed <= this->maxMissed) {
+                remap[t] = (int) kept;
+                this->tracks[kept++] = track;
+            }
+        }
+        this->tracks.resize(kept);
+        for (size_t r = 0; r < this->regions.size(); r++) {
+            Region& region = this->regions[r];
+            region.track = region.track >= 0 ? remap[region.track] : -1;
+            if (region.track < 0) {
+                Track track;
+                track.id = this->nextId++;
+                track.age = 0;
+                track.missed = 0;
+                track.line = region.line;
+                track.cx = region.cx;
+                track.cy = region.cy;
+                track.vx = track.vy = 0;
+                track.area = region.area;
+                track.x0 = region.x0;
+                track.y0 = region.y0;
+                track.x1 = region.x1;
+                track.y1 = region.y1;
+                region.track = (int) this->tracks.size();
+                this->tracks.push_back(track);
+            }
+        }
+
+        this->lineIds.assign(contour.getNumberOfLines(), -1);
+        for (size_t r = 0; r < this->regions.size(); r++) {
+            this->lineIds[this->regions[r].line] = this->tracks[this->regions[r].track].id;
+        }
+        for (size_t i = 0; i < this->labels.size(); i++) {
+            this->previous[i] = this->labels[i] >= 0 ? this->regions[this->labels[i]].track : -1;
+        }
+        return this->tracks;
+    }
+
+    // tracks after the last update(), including the ones that were missed
+    const std::vector<Track>& getTracks() const {
+        return this->tracks;
+    }
+
+    /**
+     * Track id of every contour line of the last frame, -1 for holes and
+     * short lines; e.g. for ResultServer::publish().
+     */
+    const int* getLineIds() const {
+        return this->lineIds.empty() ? NULL : &this->lineIds[0];
+    }
+
+    void reset() {
+        this->tracks.clear();
+        std::fill(this->previous.begin(), this->previous.end(), -1);
+    }
+
+    // in pixels, between predicted and observed centroid plus size difference
+    void setMaxDistance(float value) {
+        this->maxDistance = value;
+    }
+
+    float getMaxDistance() {
+        return this->maxDistance;
+    }
+
+    void setMaxMissed(int value) {
+        this->maxMissed = value;
+    }
+
+    int getMaxMissed() {
+        return this->maxMissed;
+    }
+
+    // ambiguous tracks or regions above which the greedy assignment is used
+    void setMaxAssignment(int value) {
+        this->maxAssignment = value;
+    }
+
+    int getMaxAssignment() {
+        return this->maxAssignment;
+    }
+
+    // e.g. tracker_min_contour_length
+    void setMinContourLength(int value) {
+        this->minContourLength = value;
+    }
+
+    int getMinContourLength() {
+        return this->minContourLength;
+    }
+
+    // weight of the newest centroid step in the velocity, (0, 1]
+    void setSmoothing(float value) {
+        this->smoothing = value;
+    }
+
+    float getSmoothing() {
+        return this->smoothing;
+    }
+};
+
+#endif /* TRACKASSOCIATOR_H */
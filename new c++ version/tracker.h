@@ -37,8 +37,16 @@
 #define TRACKER_H
 
 #include <homogeneity.h>
+#include <cassert>
 #include <cstring>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stdint.h>
 
 class DropStack {
 private:
@@ -47,6 +55,10 @@ private:
 
     int pos;
 
+    // sort keys, kept so that sorting every frame does not allocate
+    std::vector<int> rasterKeys;
+    std::vector<uint64_t> depthKeys;
+
 public:
 
     DropStack(int size) : x(new int[size]), y(new int[size]), pos(0) {
@@ -98,6 +110,73 @@ public:
     const int& getLastY() const {
         return this->y[this->pos - 1];
     }
+
+    // other must not hold more drops than this stack was made for
+    void copyFrom(const DropStack& other) {
+        std::memcpy(this->x, other.x, other.pos * sizeof (int));
+        std::memcpy(this->y, other.y, other.pos * sizeof (int));
+        this->pos = other.pos;
+    }
+
+    // orders the drops by row, then column; coordinates in [0, width)
+    void sortRaster(const int& width) {
+        std::vector<int>& keys = this->rasterKeys;
+        keys.resize(this->pos);
+        for (int i = 0; i < this->pos; i++) {
+            keys[i] = this->y[i] * width + this->x[i];
+        }
+        std::sort(keys.begin(), keys.end());
+        for (int i = 0; i < this->pos; i++) {
+            this->x[i] = keys[i] % width;
+            this->y[i] = keys[i] / width;
+        }
+    }
+
+    // orders the drops by decreasing depth, no value (0) counts as farthest
+    void sortByDepth(const uint16_t* depth, const int& width) {
+        std::vector<uint64_t>& keys = this->depthKeys;
+        keys.resize(this->pos);
+        for (int i = 0; i < this->pos; i++) {
+            const int index = this->y[i] * width + this->x[i];
+            const uint64_t d = depth[index] == 0 ? 65535 : depth[index];
+            keys[i] = ((65535 - d) << 32) | (uint32_t) index;
+        }
+        std::sort(keys.begin(), keys.end());
+        for (int i = 0; i < this->pos; i++) {
+            const int index = (int) (keys[i] & 0xffffffff);
+            this->x[i] = index % width;
+            this->y[i] = index / width;
+        }
+    }
+};
+
+/**
+ * What Tracker::track(deadline) got done. A partial frame has regions that
+ * are not fully grown or lines that were not traced; the drops left over are
+ * carried into the next frame. The outline of a region that is not fully
+ * grown is closed around what has been grown so far; partialLines lists
+ * those lines, consumers that want whole regions only should skip them.
+ */
+class TrackResult {
+public:
+    bool complete;
+    bool growComplete;
+    bool contourComplete;
+    int pendingDrops; // grow drops carried into the next frame
+    std::vector<int> partialLines; // contour lines next to pending drops
+
+    TrackResult() : complete(true), growComplete(true), contourComplete(true), pendingDrops(0) {
+    }
+
+    void clear() {
+        this->complete = this->growComplete = this->contourComplete = true;
+        this->pendingDrops = 0;
+        this->partialLines.clear();
+    }
+
+    bool isPartial(const int& line) const {
+        return std::binary_search(this->partialLines.begin(), this->partialLines.end(), line);
+    }
 };
 
 class Contour : public DropStack {
@@ -127,6 +206,12 @@ public:
         this->linecount = 0;
     }
 
+    void copyFrom(const Contour& other) {
+        DropStack::copyFrom(other);
+        std::memcpy(this->lines, other.lines, (other.linecount + 1) * sizeof (int));
+        this->linecount = other.linecount;
+    }
+
     const int& lineStart(const int& index) const {
         return this->lines[index];
     }
@@ -148,47 +233,163 @@ public:
     }
 };
 
-template <typename HOMOGENEITY> class Tracker {
+/**
+ * With PADDED the occupancy grid gets a one cell ring of sentinels (-1)
+ * around the frame and a row stride of dx + 2. grow() and shrink() then tell
+ * frame borders from the sentinels they read anyway instead of comparing the
+ * coordinates of every neighbour, and border con bits are generated from the
+ * sentinels. getCriteria() is only ever asked for cells inside the frame. As
+ * the rest of the code base expects a dense dx * dy grid, a padded tracker
+ * copies the interior into one when it is asked for, see getOccu().
+ *
+ * With setNumThreads() > 1 the grow step runs on several threads, see
+ * growParallel().
+ *
+ * WIDTH, HEIGHT and the seed spacings can be fixed at compile time for
+ * sensors with a known resolution, see sensormodes.h. The strides and
+ * neighbour offsets in the inner loops then are constants. 0 takes the value
+ * given to the constructor. A fixed seed spacing overrides the one given; a
+ * fixed WIDTH or HEIGHT has to match dx or dy, as the frames handed to the
+ * homogeneity have that size (asserted in the constructor).
+ */
+template <typename HOMOGENEITY, bool PADDED = false, int WIDTH = 0, int HEIGHT = 0, int SEEDSPACINGX = 0, int SEEDSPACINGY = 0> class Tracker {
 private:
     int dx, dy, nCells, seedspacingx, seedspacingy;
-    int* occu;
+    int ox; // row stride of occu
+    int* occuBuffer;
+    int* occu; // cell (0, 0) within occuBuffer
+    int* occuDense;
+    mutable bool denseValid;
     int cdx, cdy, nConCells;
     int* con;
     DropStack growList;
     DropStack shrinkList;
+    DropStack pendingList; // grow drops left by a partial frame, occu 2
     Contour contour;
     HOMOGENEITY* homogeneity;
 
+    bool budgeted;
+    std::chrono::steady_clock::time_point deadline;
+    const uint16_t* depthPriority;
+    TrackResult result;
+
+    int seedingPeriod;
+    int seedingPhase;
+    std::vector<int> seedWindows; // x0, y0, x1, y1, spacing x, spacing y per window
+
+    int numThreads;
+    bool canonicalOrder;
+    std::vector<std::vector<int> > workStacks; // x, y pairs per thread
+    std::vector<std::vector<int> > workGenerated;
+    std::vector<int> workPool; // drops shared with idle threads
+    std::mutex workMutex;
+    std::condition_variable workAvailable;
+    int workIdle;
+    bool workDone;
+    std::vector<std::thread> workers; // numThreads - 1, started by the first growParallel()
+    std::condition_variable workStart;
+    std::condition_variable workStopped;
+    uint64_t workRound; // incremented for every growParallel()
+    int workRunning; // workers still in growWorker() this round
+    bool workExit;
+
     void reinit() {
-        std::memset(this->occu, 0, this->nCells * sizeof (int));
+        std::memset(this->occuBuffer, 0, this->ox * (this->dy + 2 * PADDED) * sizeof (int));
         std::memset(this->con, 0, this->nConCells * sizeof (int));
 
+        if (PADDED) {
+            for (int x = -1; x <= this->dx; x++) {
+                this->occu[-this->ox + x] = -1;
+                this->occu[this->dy * this->ox + x] = -1;
+            }
+            for (int y = 0; y < this->dy; y++) {
+                this->occu[y * this->ox - 1] = -1;
+                this->occu[y * this->ox + this->dx] = -1;
+            }
+        }
+
         this->growList.clear();
         this->shrinkList.clear();
+        this->pendingList.clear();
     }
 
-    void findSeeders() {
-        for (int yy = 0; yy < this->dy; yy += this->seedspacingy) {
-            int line = yy * this->dx;
+    int getDx() const {
+        return WIDTH > 0 ? WIDTH : this->dx;
+    }
+
+    int getDy() const {
+        return HEIGHT > 0 ? HEIGHT : this->dy;
+    }
 
-            for (int xx = 0; xx < this->dx; xx += this->seedspacingx) {
-                int index = line + xx;
+    int getOx() const {
+        return WIDTH > 0 ? WIDTH + 2 * PADDED : this->ox;
+    }
 
-                if (this->occu[index] == 0) {
-                    if (this->homogeneity->getCriteria(xx, yy)) {
-                        this->growList.push(xx, yy);
-                        this->occu[index] = 1;
-                    }
+    int getCdx() const {
+        return WIDTH > 0 ? WIDTH + 1 : this->cdx;
+    }
+
+    int getSeedSpacingX() const {
+        return SEEDSPACINGX > 0 ? SEEDSPACINGX : this->seedspacingx;
+    }
+
+    int getSeedSpacingY() const {
+        return SEEDSPACINGY > 0 ? SEEDSPACINGY : this->seedspacingy;
+    }
+
+    void seed(const int& x, const int& y) {
+        int index = y * this->getOx() + x;
+
+        if (this->occu[index] == 0) {
+            if (this->homogeneity->getCriteria(x, y)) {
+                this->growList.push(x, y);
+                this->occu[index] = 1;
+            }
+        }
+    }
+
+    /**
+     * Scans every seedingPeriod-th row of the seed grid, starting at a row
+     * that advances by one every frame, then the seed windows.
+     */
+    void findSeeders() {
+        const int firstRow = this->seedingPeriod > 0 ? this->seedingPhase * this->getSeedSpacingY() : this->getDy();
+        for (int yy = firstRow; yy < this->getDy(); yy += this->getSeedSpacingY() * this->seedingPeriod) {
+            for (int xx = 0; xx < this->getDx(); xx += this->getSeedSpacingX()) {
+                this->seed(xx, yy);
+            }
+        }
+        this->seedingPhase = this->seedingPeriod > 0 ? (this->seedingPhase + 1) % this->seedingPeriod : 0;
+
+        for (size_t w = 0; w < this->seedWindows.size(); w += 6) {
+            const int x0 = std::max(this->seedWindows[w], 0);
+            const int y0 = std::max(this->seedWindows[w + 1], 0);
+            const int x1 = std::min(this->seedWindows[w + 2], this->getDx());
+            const int y1 = std::min(this->seedWindows[w + 3], this->getDy());
+            const int spacingX = this->seedWindows[w + 4];
+            const int spacingY = this->seedWindows[w + 5];
+
+            // a window that starts left of or above the frame keeps its lattice
+            const int sx = x0 + (spacingX - (x0 - this->seedWindows[w]) % spacingX) % spacingX;
+            const int sy = y0 + (spacingY - (y0 - this->seedWindows[w + 1]) % spacingY) % spacingY;
+            for (int yy = sy; yy < y1; yy += spacingY) {
+                for (int xx = sx; xx < x1; xx += spacingX) {
+                    this->seed(xx, yy);
                 }
             }
         }
+        this->seedWindows.clear();
     }
 
+    // pending drops (occu 2) on the shrink list are left to resume()
     void shrink() {
         int o;
 
         for (int i = 0; i < this->shrinkList.size(); i++) {
-            this->occu[this->shrinkList.getY(i) * this->dx + this->shrinkList.getX(i)] = 0;
+            int& cell = this->occu[this->shrinkList.getY(i) * this->getOx() + this->shrinkList.getX(i)];
+            if (cell != 2) {
+                cell = 0;
+            }
         }
 
         while (!this->shrinkList.isEmpty()) {
@@ -197,6 +398,10 @@ private:
 
             this->shrinkList.pop();
 
+            if (this->occu[dry * this->getOx() + drx] == 2) {
+                continue;
+            }
+
             if (this->homogeneity->getCriteria(drx, dry)) {
                 this->growList.push(drx, dry);
             } else {
@@ -205,9 +410,9 @@ private:
                 ax = drx;
                 ay = dry + 1;
 
-                o = ay * this->dx + ax;
+                o = ay * this->getOx() + ax;
 
-                if (ay < this->dy && this->occu[o] != 0) {
+                if ((PADDED || ay < this->getDy()) && this->occu[o] > 0) {
                     this->occu[o] = 0;
                     this->shrinkList.push(ax, ay);
                 }
@@ -215,9 +420,9 @@ private:
                 ax++;
                 ay--;
 
-                o += 1 - this->dx;
+                o += 1 - this->getOx();
 
-                if (ax < this->dx && this->occu[o] != 0) {
+                if ((PADDED || ax < this->getDx()) && this->occu[o] > 0) {
                     this->occu[o] = 0;
                     this->shrinkList.push(ax, ay);
                 }
@@ -225,9 +430,9 @@ private:
                 ax--;
                 ay--;
 
-                o -= this->dx + 1;
+                o -= this->getOx() + 1;
 
-                if (ay >= 0 && this->occu[o] != 0) {
+                if ((PADDED || ay >= 0) && this->occu[o] > 0) {
                     this->occu[o] = 0;
                     this->shrinkList.push(ax, ay);
                 }
@@ -235,9 +440,9 @@ private:
                 ax--;
                 ay++;
 
-                o += this->dx - 1;
+                o += this->getOx() - 1;
 
-                if (ax >= 0 && this->occu[o] != 0) {
+                if ((PADDED || ax >= 0) && this->occu[o] > 0) {
                     this->occu[o] = 0;
                     this->shrinkList.push(ax, ay);
                 }
@@ -245,14 +450,24 @@ private:
         }
 
         for (int i = 0; i < this->growList.size(); i++) {
-            this->occu[this->growList.getY(i) * this->dx + this->growList.getX(i)] = 1;
+            this->occu[this->growList.getY(i) * this->getOx() + this->growList.getX(i)] = 1;
         }
     }
 
+    bool expired() const {
+        return this->budgeted && std::chrono::steady_clock::now() >= this->deadline;
+    }
+
     void grow() {
         int o;
+        int checks = 0;
 
         while (!this->growList.isEmpty()) {
+            if (this->budgeted && (++checks & 255) == 0 && expired()) {
+                this->result.growComplete = false;
+                break;
+            }
+
             int drx = this->growList.getLastX();
             int dry = this->growList.getLastY();
 
@@ -263,12 +478,12 @@ private:
             int ax = drx;
             int ay = dry + 1;
 
-            o = ay * this->dx + ax;
+            o = ay * this->getOx() + ax;
 
-            if (ay >= this->dy) {
+            if (PADDED ? this->occu[o] < 0 : ay >= this->getDy()) {
                 generated = true;
 
-                this->con[ay * this->cdx + ax] |= 1;
+                this->con[ay * this->getCdx() + ax] |= 1;
             } else {
                 if (this->occu[o] == 0) {
                     if (this->homogeneity->getCriteria(ax, ay)) {
@@ -277,7 +492,7 @@ private:
                     } else {
                         generated = true;
 
-                        this->con[ay * this->cdx + ax] |= 1;
+                        this->con[ay * this->getCdx() + ax] |= 1;
                     }
                 }
             }
@@ -285,12 +500,12 @@ private:
             ax++;
             ay--;
 
-            o += 1 - this->dx;
+            o += 1 - this->getOx();
 
-            if (ax >= this->dx) {
+            if (PADDED ? this->occu[o] < 0 : ax >= this->getDx()) {
                 generated = true;
 
-                this->con[(ay + 1) * this->cdx + ax] |= 2;
+                this->con[(ay + 1) * this->getCdx() + ax] |= 2;
             } else {
                 if (this->occu[o] == 0) {
                     if (this->homogeneity->getCriteria(ax, ay)) {
@@ -299,7 +514,7 @@ private:
                     } else {
                         generated = true;
 
-                        this->con[(ay + 1) * this->cdx + ax] |= 2;
+                        this->con[(ay + 1) * this->getCdx() + ax] |= 2;
                     }
                 }
             }
@@ -307,12 +522,12 @@ private:
             ax--;
             ay--;
 
-            o -= this->dx + 1;
+            o -= this->getOx() + 1;
 
-            if (ay < 0) {
+            if (PADDED ? this->occu[o] < 0 : ay < 0) {
                 generated = true;
 
-                this->con[(ay + 1) * this->cdx + (ax + 1)] |= 4;
+                this->con[(ay + 1) * this->getCdx() + (ax + 1)] |= 4;
             } else {
                 if (this->occu[o] == 0) {
                     if (this->homogeneity->getCriteria(ax, ay)) {
@@ -321,7 +536,7 @@ private:
                     } else {
                         generated = true;
 
-                        this->con[(ay + 1) * this->cdx + (ax + 1)] |= 4;
+                        this->con[(ay + 1) * this->getCdx() + (ax + 1)] |= 4;
                     }
                 }
             }
@@ -329,12 +544,12 @@ private:
             ax--;
             ay++;
 
-            o += this->dx - 1;
+            o += this->getOx() - 1;
 
-            if (ax < 0) {
+            if (PADDED ? this->occu[o] < 0 : ax < 0) {
                 generated = true;
 
-                this->con[ay * this->cdx + (ax + 1)] |= 8;
+                this->con[ay * this->getCdx() + (ax + 1)] |= 8;
             } else {
                 if (this->occu[o] == 0) {
                     if (this->homogeneity->getCriteria(ax, ay)) {
@@ -343,7 +558,7 @@ private:
                     } else {
                         generated = true;
 
-                        this->con[ay * this->cdx + (ax + 1)] |= 8;
+                        this->con[ay * this->getCdx() + (ax + 1)] |= 8;
                     }
                 }
             }
@@ -354,26 +569,208 @@ private:
         }
     }
 
+    /**
+     * One neighbour of a drop in growParallel(). Claims it with a CAS if it
+     * is free and homogeneous; returns true (and sets the con bit) if it is
+     * outside the frame or neither occupied nor homogeneous.
+     */
+    bool visit(const int& ax, const int& ay, const bool& outside, const int& c, const int& bit, std::vector<int>& stack) {
+        if (!outside) {
+            int* cell = this->occu + ay * this->getOx() + ax;
+            int v = __atomic_load_n(cell, __ATOMIC_RELAXED);
+            if (v > 0) {
+                return false;
+            }
+            if (v == 0 && this->homogeneity->getCriteria(ax, ay)) {
+                int expected = 0;
+                if (__atomic_compare_exchange_n(cell, &expected, 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                    stack.push_back(ax);
+                    stack.push_back(ay);
+                }
+                return false;
+            }
+        }
+        __atomic_fetch_or(this->con + c, bit, __ATOMIC_RELAXED);
+        return true;
+    }
+
+    void growWorker(const int& id) {
+        std::vector<int>& stack = this->workStacks[id];
+        std::vector<int>& generated = this->workGenerated[id];
+        const int cdx = this->getCdx();
+
+        for (;;) {
+            while (!stack.empty()) {
+                int dry = stack.back();
+                stack.pop_back();
+                int drx = stack.back();
+                stack.pop_back();
+
+                bool g = false;
+                g |= visit(drx, dry + 1, !PADDED && dry + 1 >= this->getDy(), (dry + 1) * cdx + drx, 1, stack);
+                g |= visit(drx + 1, dry, !PADDED && drx + 1 >= this->getDx(), (dry + 1) * cdx + drx + 1, 2, stack);
+                g |= visit(drx, dry - 1, !PADDED && dry - 1 < 0, dry * cdx + drx + 1, 4, stack);
+                g |= visit(drx - 1, dry, !PADDED && drx - 1 < 0, dry * cdx + drx, 8, stack);
+                if (g) {
+                    generated.push_back(drx);
+                    generated.push_back(dry);
+                }
+
+                // hand half of a large stack to idle threads
+                if (stack.size() >= 256 && __atomic_load_n(&this->workIdle, __ATOMIC_RELAXED) > 0) {
+                    std::lock_guard<std::mutex> lock(this->workMutex);
+                    size_t half = stack.size() / 4 * 2;
+                    this->workPool.insert(this->workPool.end(), stack.end() - half, stack.end());
+                    stack.resize(stack.size() - half);
+                    this->workAvailable.notify_all();
+                }
+            }
+
+            std::unique_lock<std::mutex> lock(this->workMutex);
+            __atomic_add_fetch(&this->workIdle, 1, __ATOMIC_RELAXED);
+            while (this->workPool.empty() && !this->workDone) {
+                if (this->workIdle == this->numThreads) {
+                    this->workDone = true;
+                    this->workAvailable.notify_all();
+                    break;
+                }
+                this->workAvailable.wait(lock);
+            }
+            if (this->workDone) {
+                return;
+            }
+            __atomic_sub_fetch(&this->workIdle, 1, __ATOMIC_RELAXED);
+            size_t take = std::min(this->workPool.size(), (size_t) 256);
+            stack.insert(stack.end(), this->workPool.end() - take, this->workPool.end());
+            this->workPool.resize(this->workPool.size() - take);
+        }
+    }
+
+    // runs growWorker(id) once for every round after round until stopWorkers()
+    void workerLoop(const int id, uint64_t round) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(this->workMutex);
+                while (this->workRound == round && !this->workExit) {
+                    this->workStart.wait(lock);
+                }
+                if (this->workExit) {
+                    return;
+                }
+                round = this->workRound;
+            }
+            growWorker(id);
+            std::lock_guard<std::mutex> lock(this->workMutex);
+            if (--this->workRunning == 0) {
+                this->workStopped.notify_one();
+            }
+        }
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(this->workMutex);
+            this->workExit = true;
+            this->workStart.notify_all();
+        }
+        for (size_t t = 0; t < this->workers.size(); t++) {
+            this->workers[t].join();
+        }
+        this->workers.clear();
+        this->workExit = false;
+    }
+
+    /**
+     * grow() on numThreads threads. Every thread works off its own stack and
+     * claims cells with a compare-and-swap on occu, so each cell is grown
+     * exactly once; con bits are set with an atomic OR. A thread with a
+     * large stack shares part of it with idle threads. The occupied cells,
+     * the con bits and the set of drops in the shrink list are the same as
+     * with grow(); only the order of the shrink list differs, which is why
+     * it is sorted afterwards (see setCanonicalOrder()). getCriteria() has
+     * to be safe to call from several threads. The calling thread is worker
+     * 0; the others wait between frames and are restarted only when the
+     * number of threads changes.
+     */
+    void growParallel() {
+        const int n = this->numThreads;
+        if ((int) this->workers.size() != n - 1) {
+            stopWorkers();
+            for (int t = 1; t < n; t++) {
+                this->workers.push_back(std::thread(&Tracker::workerLoop, this, t, this->workRound));
+            }
+        }
+        this->workStacks.resize(n);
+        this->workGenerated.resize(n);
+        for (int t = 0; t < n; t++) {
+            this->workStacks[t].clear();
+            this->workGenerated[t].clear();
+        }
+        this->workPool.clear();
+
+        for (int i = 0; i < this->growList.size(); i++) {
+            std::vector<int>& stack = this->workStacks[i % n];
+            stack.push_back(this->growList.getX(i));
+            stack.push_back(this->growList.getY(i));
+        }
+        this->growList.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(this->workMutex);
+            this->workIdle = 0;
+            this->workDone = false;
+            this->workRunning = n - 1;
+            this->workRound++;
+            this->workStart.notify_all();
+        }
+        growWorker(0);
+        {
+            std::unique_lock<std::mutex> lock(this->workMutex);
+            while (this->workRunning > 0) {
+                this->workStopped.wait(lock);
+            }
+        }
+
+        for (int t = 0; t < n; t++) {
+            const std::vector<int>& generated = this->workGenerated[t];
+            for (size_t i = 0; i < generated.size(); i += 2) {
+                this->shrinkList.push(generated[i], generated[i + 1]);
+            }
+        }
+    }
+
     int dropNextToFrame(const int& x, const int& y) const {
-        if ((this->con[(y + 1) * this->cdx + x] & 1) != 0) {
+        if ((this->con[(y + 1) * this->getCdx() + x] & 1) != 0) {
             return 0;
         }
 
-        if ((this->con[(y + 1) * this->cdx + x + 1] & 2) != 0) {
+        if ((this->con[(y + 1) * this->getCdx() + x + 1] & 2) != 0) {
             return 1;
         }
 
-        if ((this->con[y * this->cdx + x] & 4) != 0) {
+        if ((this->con[y * this->getCdx() + x] & 4) != 0) {
             return 2;
         }
 
-        if ((this->con[y * this->cdx + x] & 8) != 0) {
+        if ((this->con[y * this->getCdx() + x] & 8) != 0) {
             return 3;
         }
 
         return -1;
     }
 
+    // drops the con bits of lines that were not traced, so they do not show up in the next frame
+    void clearConnections() {
+        for (int i = 0; i < this->shrinkList.size(); i++) {
+            const int x = this->shrinkList.getX(i);
+            const int y = this->shrinkList.getY(i);
+            this->con[(y + 1) * this->getCdx() + x] &= ~1;
+            this->con[(y + 1) * this->getCdx() + x + 1] &= ~2;
+            this->con[y * this->getCdx() + x + 1] &= ~4;
+            this->con[y * this->getCdx() + x] &= ~8;
+        }
+    }
+
     void makeContour() {
         this->contour.clear();
 
@@ -432,7 +829,7 @@ private:
             do {
                 this->contour.push(p0X, p0Y);
 
-                int oO = p0Y * this->cdx + p0X;
+                int oO = p0Y * this->getCdx() + p0X;
                 found = false;
 
                 if (this->con[oO] != 0) {
@@ -576,6 +973,12 @@ private:
 
             dir = -1;
 
+            if (expired()) {
+                this->result.contourComplete = false;
+                clearConnections();
+                break;
+            }
+
             while (iOfFirstUndeleted < this->shrinkList.size() && dir == -1) {
                 currX = this->shrinkList.getX(iOfFirstUndeleted);
                 currY = this->shrinkList.getY(iOfFirstUndeleted);
@@ -587,15 +990,142 @@ private:
         }
     }
 
+    /**
+     * Puts the drops a partial frame did not grow back on top of the grow
+     * list, in the order they were left, so grow() carries on where it
+     * stopped instead of revisiting what is grown already. A drop that
+     * shrink() took away (occu 0) stays away; one that is no longer
+     * homogeneous is shrunk like the boundary.
+     */
+    void resume() {
+        for (int i = 0; i < this->pendingList.size(); i++) {
+            const int x = this->pendingList.getX(i);
+            const int y = this->pendingList.getY(i);
+            int& cell = this->occu[y * this->getOx() + x];
+            if (cell == 2) {
+                if (this->homogeneity->getCriteria(x, y)) {
+                    cell = 1;
+                    this->growList.push(x, y);
+                } else {
+                    cell = 0;
+                    this->shrinkList.push(x, y);
+                }
+            }
+        }
+        this->pendingList.clear();
+        if (!this->shrinkList.isEmpty()) {
+            this->shrink();
+        }
+    }
+
+    /**
+     * Sets the con bits between the drops grow() left on the grow list and
+     * their free neighbours, as grow() does for a drop it pops, so the
+     * outline of a region that is only partly grown is closed. The drops
+     * become pending (occu 2).
+     */
+    void closeFrontier() {
+        for (int i = 0; i < this->growList.size(); i++) {
+            const int x = this->growList.getX(i);
+            const int y = this->growList.getY(i);
+            const int o = y * this->getOx() + x;
+            bool generated = false;
+
+            if (y + 1 >= this->getDy() || this->occu[o + this->getOx()] == 0) {
+                this->con[(y + 1) * this->getCdx() + x] |= 1;
+                generated = true;
+            }
+            if (x + 1 >= this->getDx() || this->occu[o + 1] == 0) {
+                this->con[(y + 1) * this->getCdx() + x + 1] |= 2;
+                generated = true;
+            }
+            if (y - 1 < 0 || this->occu[o - this->getOx()] == 0) {
+                this->con[y * this->getCdx() + x + 1] |= 4;
+                generated = true;
+            }
+            if (x - 1 < 0 || this->occu[o - 1] == 0) {
+                this->con[y * this->getCdx() + x] |= 8;
+                generated = true;
+            }
+            if (generated) {
+                this->shrinkList.push(x, y);
+            }
+        }
+        for (int i = 0; i < this->growList.size(); i++) {
+            this->occu[this->growList.getY(i) * this->getOx() + this->growList.getX(i)] = 2;
+        }
+    }
+
+    bool pendingAt(const int& x, const int& y) const {
+        return x >= 0 && y >= 0 && x < this->getDx() && y < this->getDy() && this->occu[y * this->getOx() + x] == 2;
+    }
+
+    // lines with a corner on a pending drop
+    void findPartialLines() {
+        for (int l = 0; l < this->contour.getNumberOfLines(); l++) {
+            for (int i = this->contour.lineStart(l); i < this->contour.lineEnd(l); i++) {
+                const int x = this->contour.getX(i);
+                const int y = this->contour.getY(i);
+                if (pendingAt(x, y) || pendingAt(x - 1, y) || pendingAt(x, y - 1) || pendingAt(x - 1, y - 1)) {
+                    this->result.partialLines.push_back(l);
+                    break;
+                }
+            }
+        }
+    }
+
+    void run(const bool& updateBackgroundModel) {
+        this->result.clear();
+        this->findSeeders();
+        this->shrink();
+        if (this->budgeted && this->depthPriority != NULL) {
+            this->growList.sortByDepth(this->depthPriority, this->getDx());
+        }
+        this->resume();
+        if (this->numThreads > 1) {
+            this->growParallel();
+        } else {
+            this->grow();
+        }
+        if (!this->growList.isEmpty()) {
+            this->closeFrontier();
+        }
+        if (this->canonicalOrder || this->numThreads > 1) {
+            this->shrinkList.sortRaster(this->getDx());
+        }
+        this->makeContour();
+
+        // drops grow() did not get to, see resume()
+        this->result.pendingDrops = this->growList.size();
+        if (!this->growList.isEmpty()) {
+            this->findPartialLines();
+        }
+        this->pendingList.copyFrom(this->growList);
+        this->growList.clear();
+        this->result.complete = this->result.growComplete && this->result.contourComplete;
+
+        this->denseValid = !PADDED;
+        if (updateBackgroundModel && this->result.complete) {
+            this->homogeneity->update(const_cast<int*> (this->getOccu()));
+        }
+    }
+
 public:
 
-    Tracker(int dx, int dy, int seedspacingx, int seedspacingy, HOMOGENEITY* homogeneity) : dx(dx), dy(dy), nCells(dx * dy), seedspacingx(seedspacingx), seedspacingy(seedspacingy), occu(new int[nCells]), cdx(dx + 1), cdy(dy + 1), nConCells(cdx * cdy), con(new int[nConCells]), growList(nCells), shrinkList(nCells), contour(nConCells), homogeneity(homogeneity) {
+    Tracker(int dx, int dy, int seedspacingx, int seedspacingy, HOMOGENEITY* homogeneity) : dx(WIDTH > 0 ? WIDTH : dx), dy(HEIGHT > 0 ? HEIGHT : dy), nCells(this->dx * this->dy), seedspacingx(SEEDSPACINGX > 0 ? SEEDSPACINGX : seedspacingx), seedspacingy(SEEDSPACINGY > 0 ? SEEDSPACINGY : seedspacingy), ox(this->dx + 2 * PADDED), occuBuffer(new int[(this->dx + 2 * PADDED) * (this->dy + 2 * PADDED)]), occu(occuBuffer + PADDED * (ox + 1)), occuDense(PADDED ? new int[nCells] : occu), denseValid(!PADDED), cdx(this->dx + 1), cdy(this->dy + 1), nConCells(cdx * cdy), con(new int[nConCells]), growList(nCells), shrinkList(nCells), pendingList(nCells), contour(nConCells), homogeneity(homogeneity), budgeted(false), depthPriority(NULL), seedingPeriod(1), seedingPhase(0), numThreads(1), canonicalOrder(false), workIdle(0), workDone(false), workRound(0), workRunning(0), workExit(false) {
+        assert((WIDTH <= 0 || dx == WIDTH) && (HEIGHT <= 0 || dy == HEIGHT));
         this->reinit();
     }
 
     ~Tracker() {
-        if (this->occu != NULL) {
-            delete[] this->occu;
+        stopWorkers();
+
+        if (this->occuBuffer != NULL) {
+            delete[] this->occuBuffer;
+        }
+
+        if (PADDED && this->occuDense != NULL) {
+            delete[] this->occuDense;
         }
 
         if (this->con != NULL) {
@@ -604,22 +1134,127 @@ public:
     }
 
     void track(bool updateBackgroundModel = false) {
-        this->findSeeders();
-        this->shrink();
-        this->grow();
-        this->makeContour();
-        if (updateBackgroundModel) {
-            this->homogeneity->update(this->occu);
-        }
+        this->budgeted = false;
+        this->run(updateBackgroundModel);
+    }
+
+    /**
+     * Tracks like track(), but grow() stops once deadline has passed and
+     * contour tracing stops at the first line that ends after it. The grow
+     * drops that are left keep occu 2 and are grown on first in the next
+     * frame, after shrink() has taken away what no longer belongs to a
+     * region, so a static scene converges however small the budget. With a
+     * depth priority map the seeds and regrown drops are ordered nearest
+     * first, so new regions closest to the sensor are grown before the
+     * budget runs out.
+     * The background is not updated from a partial frame. With
+     * setNumThreads() > 1 grow() runs to the end; only tracing is budgeted.
+     */
+    const TrackResult& track(const std::chrono::steady_clock::time_point& deadline, bool updateBackgroundModel = false) {
+        this->budgeted = true;
+        this->deadline = deadline;
+        this->run(updateBackgroundModel);
+        this->budgeted = false;
+        return this->result;
+    }
+
+    // result of the last track(deadline); track() always completes
+    const TrackResult& getTrackResult() const {
+        return this->result;
+    }
+
+    /**
+     * Depth map (dx * dy, mm, 0 for no value) that orders the grow list in
+     * track(deadline); has to stay valid until then. NULL keeps the order.
+     */
+    void setDepthPriority(const uint16_t* depthMap) {
+        this->depthPriority = depthMap;
     }
 
     Contour& getContour() {
         return this->contour;
     }
 
+    // dense dx * dy occupancy of the last frame
     const int* getOccu() const {
+        if (!this->denseValid) {
+            for (int y = 0; y < this->dy; y++) {
+                std::memcpy(this->occuDense + y * this->dx, this->occu + y * this->ox, this->dx * sizeof (int));
+            }
+            this->denseValid = true;
+        }
+        return occuDense;
+    }
+
+    /**
+     * The grid the tracker works on, row stride getOccuStride(). With PADDED
+     * the cells at x == -1, x == dx, y == -1 and y == dy hold -1.
+     */
+    const int* getPaddedOccu() const {
         return occu;
     }
+
+    const int& getOccuStride() const {
+        return ox;
+    }
+
+    // threads for the grow step, 1 grows serially; the extra threads live as long as the tracker
+    void setNumThreads(int value) {
+        this->numThreads = value > 0 ? value : 1;
+    }
+
+    int getNumThreads() {
+        return this->numThreads;
+    }
+
+    /**
+     * Traces the contour from a shrink list in raster order, so that the
+     * contour does not depend on the order in which grow() found the drops.
+     * Always on with more than one thread; turn it on for serial tracking to
+     * get the same contours as a parallel tracker.
+     */
+    void setCanonicalOrder(bool value) {
+        this->canonicalOrder = value;
+    }
+
+    bool getCanonicalOrder() {
+        return this->canonicalOrder;
+    }
+
+    /**
+     * Scans only every value-th row of the seed grid per frame, rotating, so
+     * every grid point is visited once in value frames. Regions found before
+     * are carried over by shrink() and grow() anyway; new ones are found
+     * within value frames, or right away inside a seed window. 0 turns the
+     * seed grid off, only the seed windows are used, see AdaptiveSeeding.
+     */
+    void setSeedingPeriod(int value) {
+        this->seedingPeriod = value > 0 ? value : 0;
+        this->seedingPhase = 0;
+    }
+
+    int getSeedingPeriod() {
+        return this->seedingPeriod;
+    }
+
+    /**
+     * Seeds the lattice (x0 + i * spacingX, y0 + j * spacingY) within
+     * [x0, x1) x [y0, y1) in the next track(), e.g. around the predicted
+     * position of a region, see MotionSeeding. spacingY 0 takes spacingX.
+     * Windows are used once.
+     */
+    void addSeedWindow(int x0, int y0, int x1, int y1, int spacingX, int spacingY = 0) {
+        this->seedWindows.push_back(x0);
+        this->seedWindows.push_back(y0);
+        this->seedWindows.push_back(x1);
+        this->seedWindows.push_back(y1);
+        this->seedWindows.push_back(spacingX > 0 ? spacingX : 1);
+        this->seedWindows.push_back(spacingY > 0 ? spacingY : this->seedWindows.back());
+    }
+
+    void clearSeedWindows() {
+        this->seedWindows.clear();
+    }
 };
 
 #endif // TRACKER_H
@@ -37,16 +37,31 @@
 #include <rotatingcaliper.h>
 #include <ConvexHull.h>
 #include <GrahamScanConvexHull.h>
+#include <mediancentroid.h>
+#include <contourmoments.h>
+#include <contourresampler.h>
+#include <depthpreprocessor.h>
+#include <motionseeding.h>
+#include <adaptiveseeding.h>
+#include <chrono>
 
 using namespace std;
 
-template <typename HOMOGENEITY> class TrackingHelper {
+template <typename HOMOGENEITY, bool PADDED = false> class TrackingHelper {
 private:
 
     Configuration configuration;
     bool configured;
     HOMOGENEITY* homogeneity;
-    Tracker<HOMOGENEITY>* tracker;
+    Tracker<HOMOGENEITY, PADDED>* tracker;
+    MedianCentroid* medianCentroid;
+    ResampledContours* resampledContours;
+    BackgroundScheduler* backgroundScheduler;
+    DepthPreprocessor* depthPreprocessor;
+    TrackAssociator* trackAssociator;
+    MotionSeeding* motionSeeding;
+    AdaptiveSeeding* adaptiveSeeding;
+    TrackResult initialResult; // until the first frame
 
     std::vector<std::pair<int, int> > contour_list;
     std::vector<std::pair<int, int> > contour_points;
@@ -63,9 +78,40 @@ public:
      */
     TrackingHelper(Configuration config, int width, int height) : configuration(config), configured(false), scalingX(1.0), scalingY(1.0) {
         homogeneity = new HOMOGENEITY(new uint16_t[width, height], width, height);
+        medianCentroid = new MedianCentroid(width, height);
+        resampledContours = NULL;
+        backgroundScheduler = NULL;
+        depthPreprocessor = new DepthPreprocessor(width, height);
+        trackAssociator = NULL;
+        motionSeeding = NULL;
+        if (configuration.tracker_track_ids || configuration.tracker_motion_seeding) {
+            trackAssociator = new TrackAssociator(width, height);
+            trackAssociator->setMinContourLength(configuration.tracker_min_contour_length);
+        }
+        if (configuration.tracker_motion_seeding) {
+            motionSeeding = new MotionSeeding();
+        }
+        adaptiveSeeding = NULL;
+        if (configuration.tracker_adaptive_seeding) {
+            adaptiveSeeding = new AdaptiveSeeding(width, height, configuration.tracker_focal_length);
+            adaptiveSeeding->setMinObjectSize(configuration.tracker_min_object_size);
+            adaptiveSeeding->setMaxDepth(configuration.maxDistance);
+            adaptiveSeeding->setBudget(configuration.tracker_frame_budget_ms);
+        }
+        if (configuration.background_tiles_per_frame > 0) {
+            backgroundScheduler = new BackgroundScheduler(width, height, configuration.tracker_num_tiles_x, configuration.tracker_num_tiles_y, configuration.background_tiles_per_frame, configuration.background_idle_frames);
+            homogeneity->setBackgroundScheduler(backgroundScheduler);
+        }
     }
 
     ~TrackingHelper() {
+        delete medianCentroid;
+        delete resampledContours;
+        delete backgroundScheduler;
+        delete depthPreprocessor;
+        delete trackAssociator;
+        delete motionSeeding;
+        delete adaptiveSeeding;
     }
 
     const int* getOccu() {
@@ -105,8 +151,8 @@ public:
     }
 
     void getCenterOfMass(Contour& contour, const int& start, const int& end, int*x, int*y) {
-        int x_ = 0;
-        int y_ = 0;
+        int64_t x_ = 0;
+        int64_t y_ = 0;
         for (int i = start; i < end; i++) {
             x_ += contour.getX(i);
             y_ += contour.getY(i);
@@ -119,20 +165,15 @@ public:
     }
 
     void getMedianCenterOfMass(Contour& contour, const int& start, const int& end, int*x, int*y) {
-        vector<int> xValues;
-        vector<int> yValues;
+        medianCentroid->getMedian(contour, start, end, x, y);
+    }
 
-        for (int i = start; i < end; i++) {
-            xValues.push_back(contour.getX(i));
-            yValues.push_back(contour.getY(i));
-        }
+    void getMedianCentersOfMass(Contour& contour, int*x, int*y) {
+        medianCentroid->getMedians(contour, x, y);
+    }
 
-        std::nth_element(xValues.begin(), xValues.begin() + xValues.size() / 2, xValues.end());
-        int medianX = xValues[xValues.size() / 2];
-        std::nth_element(yValues.begin(), yValues.begin() + yValues.size() / 2, yValues.end());
-        int medianY = yValues[yValues.size() / 2];
-        *x = medianX;
-        *y = medianY;
+    void getMoments(Contour& contour, const int& start, const int& end, RegionMoments& moments) {
+        ContourMoments().compute(contour, start, end, moments);
     }
 
     void getAxisAlignedBoundingBox(Contour& contour, const int& start, const int& end, int*x0, int*y0, int*x1, int*y1) {
@@ -185,7 +226,18 @@ public:
     }
 
     void convertFloatToUint16(const vector<float_t>& normalizedDepthMap, vector<uint16_t>& integerDepthMap, float_t maxDepthValue = 10000.0f) {
-        std::transform(normalizedDepthMap.begin(), normalizedDepthMap.end(), integerDepthMap.begin(), std::bind1st(std::multiplies<float_t>(), maxDepthValue));
+        integerDepthMap.resize(normalizedDepthMap.size());
+        if (!normalizedDepthMap.empty()) {
+            DepthPreprocessor::convert(&normalizedDepthMap[0], &integerDepthMap[0], normalizedDepthMap.size(), maxDepthValue);
+        }
+    }
+
+    /**
+     * Conversion, ROI mask and hole filling in one pass, see
+     * DepthPreprocessor. Replaces convertFloatToUint16 followed by applyMask.
+     */
+    DepthPreprocessor* getDepthPreprocessor() {
+        return depthPreprocessor;
     }
 
     void getConvexCombination(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3, int*x_ab, int*y_ab, int*x_bc, int*y_bc, int*x_cd, int*y_cd, int*x_da, int*y_da) {
@@ -264,7 +316,12 @@ public:
 
     Contour & process(uint16_t* depthMap, int width, int height) {
         if (!configured) {
-            tracker = new Tracker <HOMOGENEITY>(width, height, this->configuration.tracker_seed_spacing_x, this->configuration.tracker_seed_spacing_y, homogeneity);
+            tracker = new Tracker <HOMOGENEITY, PADDED>(width, height, this->configuration.tracker_seed_spacing_x, this->configuration.tracker_seed_spacing_y, homogeneity);
+            tracker->setNumThreads(this->configuration.tracker_num_threads);
+            tracker->setSeedingPeriod(adaptiveSeeding != NULL ? 0 : this->configuration.tracker_seeding_period);
+            if (adaptiveSeeding != NULL) {
+                adaptiveSeeding->apply(*tracker, tracker->getContour());
+            }
             configured = true;
         }
 
@@ -272,10 +329,36 @@ public:
             homogeneity->update(depthMap);
         }
 
-        tracker->track();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (configuration.tracker_deadline_ms > 0) {
+            tracker->setDepthPriority(depthMap);
+            tracker->track(start + std::chrono::microseconds((long long) (configuration.tracker_deadline_ms * 1000)), configuration.background_update);
+        } else {
+            tracker->track(configuration.background_update);
+        }
+        if (trackAssociator != NULL) {
+            const std::vector<Track>& tracks = trackAssociator->update(tracker->getContour(), tracker->getOccu());
+            if (motionSeeding != NULL) {
+                motionSeeding->apply(*tracker, tracks);
+            }
+        }
+        if (adaptiveSeeding != NULL) {
+            adaptiveSeeding->reportTime(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            adaptiveSeeding->apply(*tracker, tracker->getContour());
+        }
         return tracker->getContour();
     }
 
+    // whether the last frame was tracked completely within tracker_deadline_ms
+    const TrackResult& getTrackResult() const {
+        return configured ? tracker->getTrackResult() : initialResult;
+    }
+
+    // tracks of the regions with tracker_track_ids or tracker_motion_seeding, NULL otherwise
+    TrackAssociator* getTrackAssociator() {
+        return trackAssociator;
+    }
+
     void resampleAndConvertSingleContour(Contour& in, std::vector<std::pair<int, int> >& out, const double& sampleRate, const int& start, const int& end) {
         double step = (end - start) / sampleRate;
         for (double i = start; i < end; i += step) {
@@ -287,6 +370,20 @@ public:
         }
     }
 
+    /**
+     * Resamples every line of at least tracker_min_contour_length points to
+     * exactly samplerate arc-length uniform points. The buffer is reused by
+     * the next call; lines beyond max_resampled_contours are left out and
+     * counted by getSkippedLines().
+     */
+    ResampledContours& resampleContours(Contour& in) {
+        if (resampledContours == NULL) {
+            resampledContours = new ResampledContours((int) configuration.samplerate, configuration.max_resampled_contours);
+        }
+        ContourResampler(configuration.tracker_min_contour_length).resample(in, *resampledContours);
+        return *resampledContours;
+    }
+
     void interpolate(std::vector<std::pair<int, int> >& out, int x, int y, int x2, int y2) {
         bool yLonger = false;
         int shortLen = y2 - y;
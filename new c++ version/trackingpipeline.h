@@ -0,0 +1,269 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRACKINGPIPELINE_H
+#define TRACKINGPIPELINE_H
+
+#include <trackinghelper.h>
+#include <stdint.h>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// bounding boxes of one contour line
+class RegionGeometry {
+public:
+    int start, end; // points of the line in the contour
+    int x0, y0, x1, y1; // axis aligned
+    int obb[8]; // corners of the oriented bounding box, x, y
+};
+
+/**
+ * One frame on its way through a TrackingPipeline.
+ */
+class PipelineFrame {
+    template <typename, bool> friend class TrackingPipeline;
+
+private:
+    uint16_t* depthMap;
+    int* occu;
+    Contour contour;
+    std::vector<RegionGeometry> regions;
+    uint64_t sequence;
+
+    PipelineFrame(int width, int height) : depthMap(new uint16_t[width * height]), occu(new int[width * height]), contour((width + 1) * (height + 1)), sequence(0) {
+    }
+
+    ~PipelineFrame() {
+        if (this->depthMap != NULL) {
+            delete[] this->depthMap;
+        }
+
+        if (this->occu != NULL) {
+            delete[] this->occu;
+        }
+    }
+
+public:
+
+    const Contour& getContour() const {
+        return this->contour;
+    }
+
+    // contour lines of at least tracker_min_contour_length points
+    int getNumberOfRegions() const {
+        return (int) this->regions.size();
+    }
+
+    const RegionGeometry& getRegion(int index) const {
+        return this->regions[index];
+    }
+
+    const int* getOccu() const {
+        return this->occu;
+    }
+
+    const uint16_t* getDepthmap() const {
+        return this->depthMap;
+    }
+
+    uint64_t getSequence() const {
+        return this->sequence;
+    }
+};
+
+/**
+ * Runs the stages of consecutive frames at the same time.
+ *
+ * Each push() is one step. The calling thread tracks the new frame N + 1
+ * (seeding, shrink, grow, contour) while one worker computes the bounding
+ * boxes of frame N's contour lines and, if enabled, another updates the
+ * background model with frame N. Tracking reads the thresholds while the
+ * update writes a second set, see BackgroundModel::setDoubleBuffered(); the
+ * two are swapped when all three stages are done. So a frame takes about as
+ * long as the slowest stage, at the price of one frame of latency for the
+ * result and for the background.
+ *
+ * Frames alternate between two PipelineFrame buffers, which hold a copy of
+ * the depth map, the occupancy and the contour. The background model must
+ * derive from BackgroundModel. With updateBackground the pipeline is the only
+ * one to update the background and turns the helper's background_update off;
+ * tracking would otherwise write the model the worker is updating.
+ */
+template <typename HOMOGENEITY, bool PADDED = false> class TrackingPipeline {
+private:
+    TrackingHelper<HOMOGENEITY, PADDED>* helper;
+    int width;
+    int height;
+    bool updateBackground;
+    PipelineFrame* frames[2];
+    PipelineFrame* previous; // frame N, NULL if there is none
+    uint64_t count;
+
+    std::thread geometryThread;
+    std::thread backgroundThread;
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+    uint64_t generation;
+    int pending;
+    bool stopping;
+
+    void computeGeometry(PipelineFrame* frame) {
+        Contour& contour = frame->contour;
+        const int minLength = this->helper->getConfiguration().tracker_min_contour_length;
+        frame->regions.clear();
+        for (int i = 0; i < contour.getNumberOfLines(); i++) {
+            RegionGeometry region;
+            region.start = contour.lineStart(i);
+            region.end = contour.lineEnd(i);
+            if (region.end - region.start < minLength || region.end - region.start < 3) {
+                continue;
+            }
+            this->helper->getAxisAlignedBoundingBox(contour, region.start, region.end, &region.x0, &region.y0, &region.x1, &region.y1);
+            int* b = region.obb;
+            this->helper->getOBB(contour, region.start, region.end, &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &b[6], &b[7]);
+            frame->regions.push_back(region);
+        }
+    }
+
+    void work(bool background) {
+        uint64_t seen = 0;
+        for (;;) {
+            PipelineFrame* frame;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                while (this->generation == seen && !this->stopping) {
+                    this->started.wait(lock);
+                }
+                if (this->stopping) {
+                    return;
+                }
+                seen = this->generation;
+                frame = this->previous;
+            }
+
+            if (background) {
+                this->helper->getHomogeneity()->updateBackground(frame->depthMap, frame->occu);
+            } else {
+                computeGeometry(frame);
+            }
+
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (--this->pending == 0) {
+                this->finished.notify_one();
+            }
+        }
+    }
+
+    void startWorkers() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->pending = this->updateBackground ? 2 : 1;
+        this->generation++;
+        this->started.notify_all();
+    }
+
+    void waitForWorkers() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (this->pending > 0) {
+            this->finished.wait(lock);
+        }
+        if (this->updateBackground) {
+            this->helper->getHomogeneity()->getBackgroundModel()->swapThresholds();
+        }
+    }
+
+public:
+
+    // helper is not owned and must not be used elsewhere while the pipeline runs
+    TrackingPipeline(TrackingHelper<HOMOGENEITY, PADDED>* helper, int width, int height, bool updateBackground = true) : helper(helper), width(width), height(height), updateBackground(updateBackground), previous(NULL), count(0), generation(0), pending(0), stopping(false) {
+        this->frames[0] = new PipelineFrame(width, height);
+        this->frames[1] = new PipelineFrame(width, height);
+        if (updateBackground) {
+            helper->getConfiguration().background_update = false;
+            helper->getHomogeneity()->getBackgroundModel()->setDoubleBuffered(true);
+            this->backgroundThread = std::thread(&TrackingPipeline::work, this, true);
+        }
+        this->geometryThread = std::thread(&TrackingPipeline::work, this, false);
+    }
+
+    ~TrackingPipeline() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+            this->started.notify_all();
+        }
+        if (this->geometryThread.joinable()) {
+            this->geometryThread.join();
+        }
+        if (this->backgroundThread.joinable()) {
+            this->backgroundThread.join();
+        }
+        if (this->updateBackground) {
+            this->helper->getHomogeneity()->getBackgroundModel()->setDoubleBuffered(false);
+        }
+        delete this->frames[0];
+        delete this->frames[1];
+    }
+
+    /**
+     * Tracks depthMap and finishes the frame pushed before. Returns that
+     * frame, valid until the next push() or flush(), or NULL on the first
+     * push.
+     */
+    const PipelineFrame* push(const uint16_t* depthMap) {
+        PipelineFrame* frame = this->frames[this->count % 2];
+        PipelineFrame* done = this->previous;
+        if (done != NULL) {
+            startWorkers();
+        }
+
+        std::memcpy(frame->depthMap, depthMap, this->width * this->height * sizeof (uint16_t));
+        Contour& contour = this->helper->process(frame->depthMap, this->width, this->height);
+        frame->contour.copyFrom(contour);
+        std::memcpy(frame->occu, this->helper->getOccu(), this->width * this->height * sizeof (int));
+        frame->sequence = this->count++;
+
+        if (done != NULL) {
+            waitForWorkers();
+        }
+        this->previous = frame;
+        return done;
+    }
+
+    // finishes the last pushed frame without tracking a new one
+    const PipelineFrame* flush() {
+        PipelineFrame* done = this->previous;
+        if (done != NULL) {
+            startWorkers();
+            waitForWorkers();
+            this->previous = NULL;
+        }
+        return done;
+    }
+
+    uint64_t getCount() {
+        return this->count;
+    }
+};
+
+#endif /* TRACKINGPIPELINE_H */
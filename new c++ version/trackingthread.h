@@ -0,0 +1,148 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) 2014 Olaf Christ 
+ * email: christ_o@gmx.de
+ * 
+ * Tracking-by-growing-and-shrinking is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Tracking-by-growing-and-shrinking is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRACKINGTHREAD_H
+#define TRACKINGTHREAD_H
+
+#include <trackinghelper.h>
+#include <framering.h>
+#include <resultsnapshot.h>
+#include <sharedresultspublisher.h>
+#include <resultserver.h>
+#include <atomic>
+#include <thread>
+
+/**
+ * Runs a TrackingHelper on its own thread, fed from a FrameRing.
+ *
+ * The capture callback only writes into the ring and never waits for
+ * tracking. For every frame it takes, the thread calls process() and then
+ * the callback with the contour, the frame's sequence number and capture
+ * timestamp; the slot is handed back after the callback returns, so the
+ * callback may still read the frame. With a SnapshotPublisher every result
+ * is also published for other threads to read, with a
+ * SharedResultsPublisher for other processes and with a ResultServer for
+ * socket clients.
+ */
+template <typename HOMOGENEITY, bool PADDED = false> class TrackingThread {
+public:
+    typedef void (*Callback)(Contour& contour, uint64_t sequence, uint64_t timestamp, void* user);
+
+private:
+    TrackingHelper<HOMOGENEITY, PADDED>* helper;
+    FrameRing* ring;
+    Callback callback;
+    void* user;
+    SnapshotPublisher* publisher;
+    SharedResultsPublisher* sharedPublisher;
+    ResultServer* server;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> processed;
+    std::thread thread;
+
+    void run() {
+        while (this->running.load()) {
+            uint64_t sequence = 0;
+            uint64_t timestamp = 0;
+            const uint16_t* frame = this->ring->acquireRead(10, &sequence, &timestamp);
+            if (frame == NULL) {
+                if (this->ring->isClosed()) {
+                    break;
+                }
+                continue;
+            }
+
+            Contour& contour = this->helper->process(const_cast<uint16_t*> (frame), this->ring->getWidth(), this->ring->getHeight());
+            if (this->publisher != NULL) {
+                this->publisher->publish(contour, this->helper->getOccu(), sequence, timestamp);
+            }
+            if (this->sharedPublisher != NULL) {
+                this->sharedPublisher->publish(contour, this->helper->getOccu(), sequence, timestamp);
+            }
+            if (this->server != NULL) {
+                TrackAssociator* associator = this->helper->getTrackAssociator();
+                this->server->publish(contour, sequence, timestamp, associator != NULL ? associator->getLineIds() : NULL);
+            }
+            if (this->callback != NULL) {
+                this->callback(contour, sequence, timestamp, this->user);
+            }
+            this->ring->releaseRead();
+            this->processed++;
+        }
+    }
+
+public:
+
+    // neither helper nor ring are owned
+    TrackingThread(TrackingHelper<HOMOGENEITY, PADDED>* helper, FrameRing* ring, Callback callback = NULL, void* user = NULL) : helper(helper), ring(ring), callback(callback), user(user), publisher(NULL), sharedPublisher(NULL), server(NULL), running(false), processed(0) {
+    }
+
+    ~TrackingThread() {
+        stop();
+    }
+
+    void start() {
+        if (!this->running.load()) {
+            this->running.store(true);
+            this->thread = std::thread(&TrackingThread::run, this);
+        }
+    }
+
+    // finishes the frame in progress and joins the thread
+    void stop() {
+        this->running.store(false);
+        if (this->thread.joinable()) {
+            this->thread.join();
+        }
+    }
+
+    // set before start(); not owned
+    void setSnapshotPublisher(SnapshotPublisher* value) {
+        this->publisher = value;
+    }
+
+    SnapshotPublisher* getSnapshotPublisher() {
+        return this->publisher;
+    }
+
+    // set before start(); not owned
+    void setSharedResultsPublisher(SharedResultsPublisher* value) {
+        this->sharedPublisher = value;
+    }
+
+    SharedResultsPublisher* getSharedResultsPublisher() {
+        return this->sharedPublisher;
+    }
+
+    // set before start(); not owned
+    void setResultServer(ResultServer* value) {
+        this->server = value;
+    }
+
+    ResultServer* getResultServer() {
+        return this->server;
+    }
+
+    uint64_t getProcessed() {
+        return this->processed.load();
+    }
+};
+
+#endif /* TRACKINGTHREAD_H */